@@ -1,5 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sqlite3.h>
 
 #include "fileset.h"
@@ -10,9 +18,11 @@ open_zip(char *path, int create)
 	mz_zip_archive	*arc;
 	int		status = 0, i;
 
+	zip_writer_release(path);
 	arc = (mz_zip_archive *)calloc(1, sizeof(mz_zip_archive));
 	if (!(status = mz_zip_reader_init_file(arc, path, 0))) {
 		char *zpath = sqlite3_mprintf("%s.zip", path);
+		zip_writer_release(zpath);
 		status = mz_zip_reader_init_file(arc, zpath, 0);
 		sqlite3_free(zpath);
 	}
@@ -24,32 +34,634 @@ open_zip(char *path, int create)
 	return arc;
 }
 
+/*
+ * Hunting into zips keeps the destination archives open as writers instead
+ * of reopening and rewriting the central directory for every member.  The
+ * least recently used session is finalized when the table fills up, and
+ * everything left is finalized at exit.  SIGINT/SIGTERM/SIGHUP only raise
+ * the interrupted flag so the walk can stop and finalize cleanly.
+ *
+ * A session writes to a copy of the zip next to it, which is renamed over
+ * the zip once finalized, so whatever ends the run the zip is either as it
+ * was before or has all of the session's members.  Sources are only
+ * deleted after that.
+ */
+#define ZIP_WRITER_SLOTS 16
+
+struct zipwriter {
+	char		*path;
+	char		*tmp;	// the copy being written
+	mz_zip_archive	zip;
+	dev_t		dev;
+	ino_t		ino;
+	unsigned long	used;
+	char		**unlinks;	// sources to delete once finalized
+	int		nunlinks;
+};
+
+static struct zipwriter	writers[ZIP_WRITER_SLOTS];
+static unsigned long	writer_clock = 0;
+static int		writer_count = 0;
+volatile sig_atomic_t	interrupted = 0;
+
+static void
+zip_writer_signal(int sig)
+{
+	interrupted = 1;
+	signal(sig, SIG_DFL);
+}
+
+/*
+ * Copy the file at from to to.  Returns 0 if it couldn't be copied.
+ */
+static int
+zip_copy(char *from, char *to)
+{
+	FILE	*in, *out;
+	char	*buf;
+	size_t	n;
+	int	status = 1;
+
+	if ((in = fopen(from, "rb")) == NULL) {
+		return 0;
+	}
+	if ((out = fopen(to, "wb")) == NULL) {
+		fclose(in);
+		return 0;
+	}
+	buf = (char *)malloc(1 << 20);
+	while ((n = fread(buf, 1, 1 << 20, in)) > 0) {
+		if (fwrite(buf, 1, n, out) != n) {
+			status = 0;
+			break;
+		}
+	}
+	if (ferror(in)) {
+		status = 0;
+	}
+	free(buf);
+	fclose(in);
+	if (fclose(out) != 0) {
+		status = 0;
+	}
+
+	return status;
+}
+
+/*
+ * Make the finalized copy at path of size bytes durable, since the rename
+ * over the zip can reach the disk before its data does.
+ */
+static int
+zip_sync(char *path, mz_uint64 size)
+{
+	int fd, status;
+
+	if ((fd = open(path, O_WRONLY)) == -1) {
+		return 0;
+	}
+	// An abandoned streamed entry can leave data past the new end
+	status = ftruncate(fd, size) == 0 && fsync(fd) == 0;
+	close(fd);
+
+	return status;
+}
+
+static int
+zip_writer_finish(struct zipwriter *w)
+{
+	mz_uint64 size;
+	int status = 1;
+	int i;
+
+	if (!mz_zip_writer_finalize_archive(&w->zip)) {
+		fprintf(stderr, "error: couldn't finalize %s\n", w->path);
+		status = 0;
+	}
+	size = w->zip.m_archive_size;
+	mz_zip_writer_end(&w->zip);
+	if (status && (!zip_sync(w->tmp, size) || rename(w->tmp, w->path) != 0)) {
+		fprintf(stderr, "error: couldn't replace %s\n", w->path);
+		status = 0;
+	}
+	if (!status) {
+		unlink(w->tmp);
+	}
+	for (i = 0; i < w->nunlinks; i++) {
+		if (status) {
+			unlink(w->unlinks[i]);
+		}
+		sqlite3_free(w->unlinks[i]);
+	}
+	free(w->unlinks);
+	sqlite3_free(w->path);
+	sqlite3_free(w->tmp);
+	memset(w, 0, sizeof(struct zipwriter));
+	writer_count--;
+
+	return status;
+}
+
+mz_zip_archive *
+zip_writer_get(char *path)
+{
+	static int	registered = 0;
+	struct zipwriter *w = NULL;
+	struct stat	sb;
+	int		status, i;
+
+	for (i = 0; i < ZIP_WRITER_SLOTS; i++) {
+		if (writers[i].path == NULL) {
+			if (w == NULL || w->path != NULL) {
+				w = &writers[i];
+			}
+		} else if (!strcmp(writers[i].path, path)) {
+			writers[i].used = ++writer_clock;
+			return &writers[i].zip;
+		} else if (w == NULL || (w->path != NULL && writers[i].used < w->used)) {
+			w = &writers[i];
+		}
+	}
+
+	if (!registered) {
+		atexit(zip_writer_close_all);
+		signal(SIGINT, zip_writer_signal);
+		signal(SIGTERM, zip_writer_signal);
+		signal(SIGHUP, zip_writer_signal);
+		registered = 1;
+	}
+	if (w->path != NULL) {
+		zip_writer_finish(w);
+	}
+
+	w->tmp = sqlite3_mprintf("%s.tmp", path);
+	if (stat(path, &sb) == 0) {
+		status = zip_copy(path, w->tmp) &&
+		    mz_zip_reader_init_file(&w->zip, w->tmp, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY);
+		if (status && !(status = mz_zip_writer_init_from_reader(&w->zip, w->tmp))) {
+			mz_zip_reader_end(&w->zip);
+		}
+	} else if ((status = mz_zip_writer_init_file(&w->zip, w->tmp, 0))) {
+		stat(w->tmp, &sb);
+	}
+	if (!status) {
+		unlink(w->tmp);
+		sqlite3_free(w->tmp);
+		memset(w, 0, sizeof(struct zipwriter));
+		return NULL;
+	}
+	w->path = sqlite3_mprintf("%s", path);
+	w->dev = sb.st_dev;
+	w->ino = sb.st_ino;
+	w->used = ++writer_clock;
+	writer_count++;
+
+	return &w->zip;
+}
+
+void
+zip_writer_defer_unlink(mz_zip_archive *zip, char *src)
+{
+	int i;
+
+	for (i = 0; i < ZIP_WRITER_SLOTS; i++) {
+		struct zipwriter *w = &writers[i];
+		if (w->path != NULL && &w->zip == zip) {
+			w->unlinks = (char **)realloc(w->unlinks, (w->nunlinks + 1) * sizeof(char *));
+			w->unlinks[w->nunlinks++] = sqlite3_mprintf("%s", src);
+			return;
+		}
+	}
+	unlink(src);
+}
+
+/*
+ * Finalize the session writing to path, if any, so it can be read back.
+ * A zip that's new to the session isn't at path until then, and can't be
+ * read back before.
+ */
+void
+zip_writer_release(char *path)
+{
+	struct stat	sb;
+	int		i;
+
+	if (writer_count == 0 || stat(path, &sb) != 0) {
+		return;
+	}
+	for (i = 0; i < ZIP_WRITER_SLOTS; i++) {
+		if (writers[i].path != NULL && writers[i].dev == sb.st_dev && writers[i].ino == sb.st_ino) {
+			zip_writer_finish(&writers[i]);
+		}
+	}
+}
+
+void
+zip_writer_close_all(void)
+{
+	int i;
+
+	for (i = 0; i < ZIP_WRITER_SLOTS; i++) {
+		if (writers[i].path != NULL) {
+			zip_writer_finish(&writers[i]);
+		}
+	}
+}
+
+static char *rar_password(char *);
+
+/*
+ * Volume and password requests on rar handles opened for extraction, or
+ * for listing when there are passwords to try.  user is the path the
+ * archive was opened by, which the password list is tried on the first
+ * time something in it turns out to be encrypted.  The wide variants come
+ * first; answering them with 0 hands the request on to the narrow one.
+ */
 int CALLBACK
-rar_extract_to_mem(unsigned int msg, long user, long p1, long p2)
+rar_callback(unsigned int msg, long user, long p1, long p2)
 {
+	char *password;
+
 	switch (msg) {
 	case UCM_CHANGEVOLUME:
-		switch (p2) {
-		case RAR_VOL_ASK:
+		if (p2 == RAR_VOL_ASK) {
 			fprintf(stderr, "Next volume in archive (%s) is missing.\n", (char *)p1);
 			return -1;
-		case RAR_VOL_NOTIFY:
-			return 1;
 		}
-		break;
-	case UCM_PROCESSDATA:
-		memcpy(*(char **)user, (char *)p1, p2);
-		*(char **)user += p2;
 		return 1;
-		break;
 	case UCM_NEEDPASSWORD:
-		fprintf(stderr, "Passworded rars aren't supported yet.\n");
+		if (user == 0 || (password = rar_password((char *)user)) == NULL) {
+			fprintf(stderr, "Passworded rar and no password that opens it, see -p.\n");
+			return -1;
+		}
+		strncpy((char *)p1, password, p2 - 1);
+		((char *)p1)[p2 - 1] = '\0';
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Same as rar_callback(), for handles trying the password user.
+ */
+static int CALLBACK
+rar_try_callback(unsigned int msg, long user, long p1, long p2)
+{
+	if (msg == UCM_NEEDPASSWORD) {
+		strncpy((char *)p1, (char *)user, p2 - 1);
+		((char *)p1)[p2 - 1] = '\0';
+		return 1;
+	}
+
+	return rar_callback(msg, 0, p1, p2);
+}
+
+/*
+ * Passwords given with -p are tried in turn on the smallest encrypted
+ * member of each rar, or on its headers if those are encrypted, and the one
+ * that fits is kept for the next handle on the same archive.  Every try
+ * derives a key, which with -k goes through the key store in the database,
+ * so later volumes and later runs over the same archives don't derive it
+ * again.
+ */
+static char		**passwords;
+static int		npasswords;
+static char		*password_path;	// archive password_found is for
+static char		*password_found;
+static pthread_mutex_t	password_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static HANDLE rar_open_callback(HANDLE, char *, int, UNRARCALLBACK, long);
+
+/*
+ * Read the passwords to try, one per line, from path.  Returns -1 if it
+ * can't be read.
+ */
+int
+rar_load_passwords(char *path)
+{
+	FILE	*in;
+	char	*line = NULL;
+	size_t	nchars = 0;
+	ssize_t	len;
+
+	if ((in = fopen(path, "r")) == NULL) {
+		fprintf(stderr, "couldn't open %s\n", path);
 		return -1;
 	}
+	while ((len = getline(&line, &nchars, in)) >= 0) {
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+			line[--len] = '\0';
+		}
+		if (len == 0) {
+			continue;
+		}
+		passwords = (char **)realloc(passwords, (npasswords + 1) * sizeof(char *));
+		passwords[npasswords++] = strdup(line);
+	}
+	free(line);
+	fclose(in);
+
+	return 0;
 }
 
+/*
+ * Returns 1 if password opens the rar at path, 0 if it doesn't, or -1 if
+ * nothing in it is encrypted.  Empty members and directories pass
+ * RAR_TEST with any password, so only members with data are tested.
+ */
+static int
+rar_try_password(char *path, char *password)
+{
+	struct RARHeaderDataSlim hdr;
+	HANDLE			rararc;
+	unsigned long long	pos = ~0ULL, size = 0;
+	int			fits = -1, status;
+
+	if ((rararc = rar_open_callback(NULL, path, 1, rar_try_callback, (long)password)) == NULL) {
+		return 0;
+	}
+	for (;;) {
+		if ((status = RARReadHeaderSlim(rararc, &hdr)) != 0) {
+			// Encrypted headers fail their CRC with a wrong
+			// password
+			if (status != ERAR_END_ARCHIVE) {
+				fits = 0;
+			}
+			break;
+		}
+		if ((hdr.Flags & 0x04) && !(hdr.Flags & 0x03) && hdr.UnpVer < 50 &&
+		    hdr.UnpSize > 0 && (hdr.Flags & 0xe0) != 0xe0) {
+			// Members of solid archives can only be tested in order
+			if (hdr.HeaderPos == ~0ULL) {
+				fits = RARProcessFile(rararc, RAR_TEST, NULL, NULL) == 0;
+				break;
+			}
+			if (pos == ~0ULL || hdr.UnpSize < size) {
+				pos = hdr.HeaderPos;
+				size = hdr.UnpSize;
+			}
+		}
+		RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+	}
+	if (fits == -1 && pos != ~0ULL) {
+		fits = RARSeekHeader(rararc, pos) == 0 &&
+		    RARReadHeaderSlim(rararc, &hdr) == 0 &&
+		    RARProcessFile(rararc, RAR_TEST, NULL, NULL) == 0;
+	}
+	rar_close(rararc);
+
+	return fits;
+}
+
+/*
+ * The password from the list that opens the rar at path, or NULL if none
+ * does or it isn't encrypted.  Only asked for by rar_callback(), when an
+ * encrypted header or member is met.
+ */
+static char *
+rar_password(char *path)
+{
+	char	*password = NULL;
+	int	i, fits = 0;
+
+	if (npasswords == 0) {
+		return NULL;
+	}
+	pthread_mutex_lock(&password_lock);
+	if (password_path != NULL && !strcmp(password_path, path)) {
+		password = password_found;
+	} else {
+		for (i = 0; i < npasswords; i++) {
+			if ((fits = rar_try_password(path, passwords[i])) != 0) {
+				break;
+			}
+		}
+		if (fits == 1) {
+			password = passwords[i];
+		} else if (fits == 0) {
+			fprintf(stderr, "error: no password in the list opens %s\n", path);
+		}
+		free(password_path);
+		password_path = strdup(path);
+		password_found = password;
+	}
+	pthread_mutex_unlock(&password_lock);
+
+	return password;
+}
+
+static int PASCAL
+rar_key_find(void *opaque, const unsigned char *id, unsigned char *key)
+{
+	sqlite3_stmt	*stmt;
+	int		found = 0;
+
+	if (sqlite3_prepare_v2((sqlite3 *)opaque, "SELECT key FROM rarkeys WHERE id=@ID", -1, &stmt, NULL) != SQLITE_OK) {
+		return 0;
+	}
+	sqlite3_bind_blob(stmt, 1, id, 20, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == 32) {
+		memcpy(key, sqlite3_column_blob(stmt, 0), 32);
+		found = 1;
+	}
+	sqlite3_finalize(stmt);
+
+	return found;
+}
+
+static void PASCAL
+rar_key_put(void *opaque, const unsigned char *id, const unsigned char *key)
+{
+	sqlite3_stmt	*stmt;
+
+	if (sqlite3_prepare_v2((sqlite3 *)opaque, "INSERT OR REPLACE INTO rarkeys (id, key) VALUES (@ID, @KEY)", -1, &stmt, NULL) != SQLITE_OK) {
+		return;
+	}
+	sqlite3_bind_blob(stmt, 1, id, 20, SQLITE_STATIC);
+	sqlite3_bind_blob(stmt, 2, key, 32, SQLITE_STATIC);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+}
+
+/*
+ * Keep keys derived for encrypted rars in db, under ids keyed with a random
+ * secret made for the db the first time.  The secret is in the db too, so
+ * whoever has a copy of it can test password guesses against the ids
+ * without deriving keys, and can decrypt the archives with the keys, which
+ * is why this is only done with -k.  The store is called from worker
+ * threads too, which is fine as sqlite serializes use of the connection.
+ * Returns -1 if there's no secret and one can't be made.
+ */
+int
+rar_set_key_db(sqlite3 *db)
+{
+	static struct RARKeyStore	store = {rar_key_find, rar_key_put, NULL, NULL, 0};
+	static unsigned char		secret[20];
+	sqlite3_stmt			*stmt;
+	int				found = 0;
+
+	if (sqlite3_prepare_v2(db, "SELECT secret FROM rarsecret", -1, &stmt, NULL) != SQLITE_OK) {
+		return -1;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == sizeof(secret)) {
+		memcpy(secret, sqlite3_column_blob(stmt, 0), sizeof(secret));
+		found = 1;
+	}
+	sqlite3_finalize(stmt);
+
+	if (!found) {
+		FILE *in;
+
+		if ((in = fopen("/dev/urandom", "r")) == NULL ||
+		    fread(secret, 1, sizeof(secret), in) != sizeof(secret)) {
+			if (in != NULL) {
+				fclose(in);
+			}
+			return -1;
+		}
+		fclose(in);
+		if (sqlite3_prepare_v2(db, "INSERT INTO rarsecret (secret) VALUES (@SECRET)", -1, &stmt, NULL) != SQLITE_OK) {
+			return -1;
+		}
+		sqlite3_bind_blob(stmt, 1, secret, sizeof(secret), SQLITE_STATIC);
+		found = sqlite3_step(stmt) == SQLITE_DONE;
+		sqlite3_finalize(stmt);
+		if (!found) {
+			return -1;
+		}
+	}
+
+	store.Opaque = db;
+	store.Secret = secret;
+	store.SecretSize = sizeof(secret);
+	RARSetKeyStore(&store);
+
+	return 0;
+}
+
+/*
+ * Members up to RAR_WHOLE_MAX are unpacked straight into a buffer sized from
+ * the header, the copy out of the unpack window doubling as the CRC pass, so
+ * zip_add_mem() can deflate them in parallel.  Larger ones go through a sink
+ * that gets the data from the unpack window and deflates it into the zip as
+ * it arrives, so memory use doesn't grow with the member.
+ */
+struct rarstream {
+	mz_zip_writer_stream	zs;
+	unsigned int		crc;
+};
+
+static int PASCAL
+rar_stream_write(void *opaque, const unsigned char *data, size_t n)
+{
+	struct rarstream *s = (struct rarstream *)opaque;
+
+	return mz_zip_writer_add_stream_write(&s->zs, data, n);
+}
+
+static int PASCAL
+rar_stream_finish(void *opaque, unsigned int crc)
+{
+	struct rarstream *s = (struct rarstream *)opaque;
+
+	return crc == s->crc && mz_zip_writer_add_stream_end(&s->zs);
+}
+
+/*
+ * Unpack the member hdr was just read for into a buffer sized from the
+ * header.  Returns the buffer, which the caller frees, or NULL if it
+ * couldn't be unpacked.
+ */
+unsigned char *
+rar_extract_to_mem(HANDLE rararc, struct RARHeaderDataSlim *hdr)
+{
+	unsigned char	*buf;
+	unsigned int	crc;
+
+	if ((buf = (unsigned char *)malloc(hdr->UnpSize ? hdr->UnpSize : 1)) == NULL) {
+		RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+		return NULL;
+	}
+	if (RARProcessFileToMem(rararc, buf, hdr->UnpSize, &crc) != 0 ||
+	    crc != hdr->FileCRC) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/*
+ * Extract the member hdr was just read for into zip as name.  Returns 0 if
+ * it couldn't be extracted or added.
+ */
+int
+rar_extract_to_zip(HANDLE rararc, struct RARHeaderDataSlim *hdr, mz_zip_archive *zip, char *name, int level)
+{
+	if (hdr->UnpSize <= RAR_WHOLE_MAX) {
+		unsigned char	*buf;
+		int		status;
+
+		if ((buf = rar_extract_to_mem(rararc, hdr)) == NULL) {
+			return 0;
+		}
+		status = zip_add_mem(zip, name, buf, hdr->UnpSize, level);
+		free(buf);
+
+		return status;
+	} else {
+		struct rarstream	s;
+		struct RARDataSink	sink = {rar_stream_write, rar_stream_finish, &s};
+
+		s.crc = hdr->FileCRC;
+		if (!mz_zip_writer_add_stream_begin(zip, &s.zs, name, level)) {
+			RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+			return 0;
+		}
+		if (RARProcessFileToSink(rararc, &sink) != 0) {
+			mz_zip_writer_add_stream_abort(&s.zs);
+			return 0;
+		}
+
+		return 1;
+	}
+}
+
+/*
+ * Rar handles are released back to this pool rather than freed, so the
+ * next rar_open() reuses their buffers and unpack window.
+ */
+static HANDLE rarpool;
+
 HANDLE
 rar_open(char *path, int extract)
+{
+	if (rarpool == NULL && (rarpool = RARCreatePool()) == NULL) {
+		return NULL;
+	}
+
+	return rar_open_pool(rarpool, path, extract);
+}
+
+/*
+ * Same as rar_open() through a pool of the caller's, or none if pool is
+ * NULL.  Pools aren't locked, so threads other than the main one need
+ * their own.  The password for the archive is looked up by path, which has
+ * to stay valid until the handle is closed.
+ */
+HANDLE
+rar_open_pool(HANDLE pool, char *path, int extract)
+{
+	if (!extract && npasswords == 0) {
+		return rar_open_callback(pool, path, extract, NULL, 0);
+	}
+
+	return rar_open_callback(pool, path, extract, rar_callback, (long)path);
+}
+
+static HANDLE
+rar_open_callback(HANDLE pool, char *path, int extract, UNRARCALLBACK callback, long user)
 {
 	HANDLE arc;
 	struct RAROpenArchiveDataEx in = {0};
@@ -61,20 +673,107 @@ rar_open(char *path, int extract)
 		in.OpenMode = RAR_OM_LIST;
 	}
 
-	if ((arc = RAROpenArchiveEx(&in)) == NULL) {
+	if ((arc = RAROpenArchivePooled(pool, &in)) == NULL) {
 		char *rpath = sqlite3_mprintf("%s.rar", path);
 		in.ArcName = rpath;
-		arc = RAROpenArchiveEx(&in);
+		arc = RAROpenArchivePooled(pool, &in);
 		sqlite3_free(rpath);
 	}
+	if (arc != NULL && callback != NULL) {
+		RARSetCallback(arc, callback, user);
+	}
 
 	return arc;
 }
 
+/*
+ * Whether the rar at name is a volume of a set with .rev recovery volumes
+ * next to it.  Those share the name of the volumes up to their number, as
+ * in set.part1.rar and set.part1.rev, or up to .rar in the old naming.
+ */
+static int
+rar_has_rev(char *name)
+{
+	struct RAROpenArchiveDataEx	in = {0};
+	struct dirent			*ent;
+	HANDLE				arc;
+	DIR				*dir;
+	char				*dname, *stem, *ext;
+	size_t				len;
+	int				found = 0;
+
+	in.ArcName = name;
+	in.OpenMode = RAR_OM_LIST;
+	if ((arc = RAROpenArchiveEx(&in)) == NULL) {
+		return 0;
+	}
+	RARCloseArchive(arc);
+	if (!(in.Flags & 0x01)) {
+		return 0;
+	}
+
+	if ((stem = strrchr(name, '/')) != NULL) {
+		dname = sqlite3_mprintf("%.*s", (int)(stem - name), name);
+		stem = sqlite3_mprintf("%s", stem + 1);
+	} else {
+		dname = sqlite3_mprintf(".");
+		stem = sqlite3_mprintf("%s", name);
+	}
+	if ((ext = strrchr(stem, '.')) != NULL && strcasecmp(ext, ".rar") == 0) {
+		*ext = '\0';
+	}
+	for (ext = stem + strlen(stem); ext > stem && ext[-1] >= '0' && ext[-1] <= '9'; ext--)
+		;
+	if (ext - stem >= 5 && strncasecmp(ext - 5, ".part", 5) == 0) {
+		*ext = '\0';
+	}
+
+	len = strlen(stem);
+	if ((dir = opendir(dname)) != NULL) {
+		while (!found && (ent = readdir(dir)) != NULL) {
+			size_t n = strlen(ent->d_name);
+
+			found = n >= len + 4 && strncmp(ent->d_name, stem, len) == 0 &&
+			    strcasecmp(ent->d_name + n - 4, ".rev") == 0;
+		}
+		closedir(dir);
+	}
+	sqlite3_free(dname);
+	sqlite3_free(stem);
+
+	return found;
+}
+
+/*
+ * Rebuild the missing or damaged volumes of the set the rar at path (or
+ * path.rar) belongs to from its .rev recovery volumes.  Damaged volumes
+ * are kept with .bad added to their names.  Returns 0 if any were rebuilt,
+ * and -1 without trying if the rar isn't a volume or there are no .rev
+ * files for its set.
+ */
+int
+rar_restore(char *path)
+{
+	struct stat	sb;
+	char		*rpath;
+	int		status = -1;
+
+	if (stat(path, &sb) == 0) {
+		return rar_has_rev(path) ? RARRestoreVolumes(path) : -1;
+	}
+	rpath = sqlite3_mprintf("%s.rar", path);
+	if (rar_has_rev(rpath)) {
+		status = RARRestoreVolumes(rpath);
+	}
+	sqlite3_free(rpath);
+
+	return status;
+}
+
 void
 rar_close(HANDLE rararc)
 {
-	RARCloseArchive(rararc);
+	RARReleaseArchive(rararc);
 }
 
 int
@@ -83,9 +782,9 @@ rar_get_num_files(HANDLE rararc)
 	int count = 0;
 
 	for (;;) {
-		struct RARHeaderDataEx hdr = {0};
+		struct RARHeaderDataSlim hdr;
 		int retval;
-		if ((retval = RARReadHeaderEx(rararc, &hdr)) != 0) {
+		if ((retval = RARReadHeaderSlim(rararc, &hdr)) != 0) {
 			break;
 		}
 		RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
@@ -0,0 +1,480 @@
+// Benchmarks for the unrar library. Each mode times one part of it, best
+// of -n runs, and fails if the results don't check out:
+//
+//   list archive...      walk the headers of each archive
+//   unpack archive...    test every member of each archive
+//   filter file          run the standard filters over the start of file
+//                        at each SSE level, checked against the scalar code
+//   vm                   run a generic RarVM program over a 128KB block
+//                        with the switch loop and with threaded code
+//   aes                  CBC decrypt 1MB with the tables and with AES-NI
+//   rs                   rebuild 3 of 13 1MB volumes with a Decode per byte
+//                        and with MulAdd at each SSE level
+#include "rar.hpp"
+#include <time.h>
+
+static int Reps=10;
+
+
+static double Now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec+ts.tv_nsec/1e9);
+}
+
+
+// Read every header of ArcName with RARReadHeaderSlim and skip the data,
+// as listing does.
+// Returns the number of headers, or -1 if the archive is bad.
+static int ListArchive(char *ArcName)
+{
+  RAROpenArchiveDataEx in;
+  memset(&in,0,sizeof(in));
+  in.ArcName=ArcName;
+  in.OpenMode=RAR_OM_LIST;
+  HANDLE hArc=RAROpenArchiveEx(&in);
+  if (hArc==NULL)
+    return(-1);
+  RARHeaderDataSlim hd;
+  int Count=0,Code;
+  while ((Code=RARReadHeaderSlim(hArc,&hd))==0)
+  {
+    Count++;
+    if ((Code=RARProcessFile(hArc,RAR_SKIP,NULL,NULL))!=0)
+      break;
+  }
+  RARCloseArchive(hArc);
+  return(Code==ERAR_END_ARCHIVE ? Count:-1);
+}
+
+
+static int BenchList(int Argc,char *Argv[])
+{
+  int Errors=0;
+  for (int I=0;I<Argc;I++)
+  {
+    int Count=0;
+    double Best=1e9;
+    for (int R=0;R<Reps && Count>=0;R++)
+    {
+      double T=Now();
+      Count=ListArchive(Argv[I]);
+      if ((T=Now()-T)<Best)
+        Best=T;
+    }
+    if (Count<0)
+    {
+      fprintf(stderr,"%s: bad archive\n",Argv[I]);
+      Errors++;
+      continue;
+    }
+    printf("%s: %d headers in %.2f ms, %.0f headers/s\n",Argv[I],Count,
+           Best*1e3,Count/Best);
+  }
+  return(Errors);
+}
+
+
+static int CALLBACK CountData(UINT Msg,LPARAM UserData,LPARAM P1,LPARAM P2)
+{
+  switch(Msg)
+  {
+    case UCM_CHANGEVOLUME:
+      return(P2==RAR_VOL_NOTIFY ? 1:-1);
+    case UCM_PROCESSDATA:
+      *(int64 *)UserData+=P2;
+      return(1);
+  }
+  return(0);
+}
+
+
+// Test every member of ArcName, which checks its CRC. Returns the number
+// of bytes unpacked, or -1 if the archive or a member is bad, and the
+// number of members in Members.
+static int64 UnpackArchive(char *ArcName,int &Members)
+{
+  Members=0;
+  int64 Size=0;
+  RAROpenArchiveDataEx in;
+  memset(&in,0,sizeof(in));
+  in.ArcName=ArcName;
+  in.OpenMode=RAR_OM_EXTRACT;
+  in.Callback=CountData;
+  in.UserData=(LPARAM)&Size;
+  HANDLE hArc=RAROpenArchiveEx(&in);
+  if (hArc==NULL)
+    return(-1);
+  RARHeaderDataEx hd;
+  int Code;
+  while ((Code=RARReadHeaderEx(hArc,&hd))==0)
+  {
+    Members++;
+    if ((Code=RARProcessFile(hArc,RAR_TEST,NULL,NULL))!=0)
+      break;
+  }
+  RARCloseArchive(hArc);
+  return(Code==ERAR_END_ARCHIVE ? Size:-1);
+}
+
+
+static int BenchUnpack(int Argc,char *Argv[])
+{
+  int Errors=0;
+  for (int I=0;I<Argc;I++)
+  {
+    int64 Size=0;
+    int Members=0;
+    double Best=1e9;
+    for (int R=0;R<Reps && Size>=0;R++)
+    {
+      double T=Now();
+      Size=UnpackArchive(Argv[I],Members);
+      if ((T=Now()-T)<Best)
+        Best=T;
+    }
+    if (Size<0)
+    {
+      fprintf(stderr,"%s: bad archive\n",Argv[I]);
+      Errors++;
+      continue;
+    }
+    // Per member setup, like the PPMd heap, shows in archives of many
+    // small members.
+    printf("%s: %d members, %lld bytes in %.2f ms, %.1f MB/s\n",Argv[I],
+           Members,(long long)Size,Best*1e3,Size/Best/1e6);
+  }
+  return(Errors);
+}
+
+
+static bool LoadFile(char *FileName,byte *Buf,size_t Size)
+{
+  FILE *f=fopen(FileName,"rb");
+  if (f==NULL)
+    return(false);
+  size_t Read=fread(Buf,1,Size,f);
+  fclose(f);
+  if (Read==0)
+    return(false);
+  // Repeat short files to fill the buffer.
+  for (size_t I=Read;I<Size;I++)
+    Buf[I]=Buf[I-Read];
+  return(true);
+}
+
+
+static int BenchFilter(int Argc,char *Argv[])
+{
+  // DELTA and RGB take blocks below VM_GLOBALMEMADDR/2.
+  const uint Size=0x1c000,Loops=64;
+  static struct
+  {
+    const char *Name;
+    VM_StandardFilters Type;
+    uint Param[2];
+  } Filters[]={
+    {"e8",VMSF_E8,{0,0}},{"e8e9",VMSF_E8E9,{0,0}},
+    {"delta1",VMSF_DELTA,{1,0}},{"delta2",VMSF_DELTA,{2,0}},
+    {"delta3",VMSF_DELTA,{3,0}},{"delta4",VMSF_DELTA,{4,0}},
+    {"rgb",VMSF_RGB,{3*640+3,0}},{"audio",VMSF_AUDIO,{4,0}},
+  };
+  if (Argc!=1)
+    return(1);
+  Array<byte> Src(Size),Dest(Size),Ref(Size);
+  if (!LoadFile(Argv[0],&Src[0],Size))
+  {
+    fprintf(stderr,"%s: can't read\n",Argv[0]);
+    return(1);
+  }
+  RarVM VM;
+  VM.Init();
+  // The filters pick their code by _SSE_Version, SSE_NONE is the scalar one.
+  const char *LevelNames[]={"scalar","sse2","avx2"};
+#ifdef USE_SSE
+  const SSE_VERSION Levels[]={SSE_NONE,SSE_SSE2,SSE_AVX2};
+  const SSE_VERSION Detected=_SSE_Version;
+  const uint LevelCount=ASIZE(Levels);
+#else
+  const uint LevelCount=1;
+#endif
+  int Errors=0;
+  for (uint F=0;F<ASIZE(Filters);F++)
+    for (uint L=0;L<LevelCount;L++)
+    {
+#ifdef USE_SSE
+      if (Levels[L]>Detected)
+        break;
+      _SSE_Version=Levels[L];
+#endif
+      double Best=1e9;
+      for (int R=0;R<Reps;R++)
+      {
+        double T=Now();
+        for (uint I=0;I<Loops;I++)
+          VM.ApplyStandardFilter(Filters[F].Type,Filters[F].Param,&Src[0],&Dest[0],Size,0);
+        if ((T=Now()-T)<Best)
+          Best=T;
+      }
+      bool Same=true;
+      if (L==0)
+        memcpy(&Ref[0],&Dest[0],Size);
+      else
+        Same=memcmp(&Ref[0],&Dest[0],Size)==0;
+      if (!Same)
+        Errors++;
+      printf("%-7s %-7s %7.1f MB/s%s\n",Filters[F].Name,LevelNames[L],
+             (double)Size*Loops/Best/1e6,Same ? "":"  differs from scalar");
+    }
+#ifdef USE_SSE
+  _SSE_Version=Detected;
+#endif
+  return(Errors);
+}
+
+
+// RarVM code for a byte loop, 9 commands per byte, as a custom filter
+// in an archive would carry it:
+//   mov r0,0; mov r2,0
+//   L: movzx r1,[r0]; xor r1,0x5a; add r1,r2; mov byte [r0],r1
+//      mov r2,r1; shr r2,1; inc r0; cmp r0,r4; jb L
+//   mov [#VM_GLOBALMEMADDR+0x20],0; ret
+static byte VMLoopCode[]={
+  0xad,0x02,0x00,0x01,0x40,0x1c,0x4a,0x10,0xa4,0x80,0x16,0x89,0x34,0x14,0x24,0x15,
+  0x38,0xa8,0x05,0x90,0x28,0xc9,0xc8,0x04,0x08,0x0f,0x80,0x01,0xe0,0x10,0x00,0x5c
+};
+
+
+static int BenchVM(int Argc,char *Argv[])
+{
+  const uint Size=0x20000,LoopCmds=9;
+  Array<byte> Src(Size),Ref(Size);
+  uint Prev=0;
+  for (uint I=0;I<Size;I++)
+  {
+    Src[I]=byte(I*7+(I>>9));
+    uint V=(Src[I]^0x5a)+Prev;
+    Ref[I]=byte(V);
+    Prev=V>>1;
+  }
+
+  RarVM VM;
+  VM.Init();
+  VM_PreparedProgram Prg;
+  VM.Prepare(VMLoopCode,sizeof(VMLoopCode),&Prg);
+  const char *Names[]={"switch","threaded"};
+  int Errors=0;
+  for (int N=0;N<2;N++)
+  {
+    VM.SetThreadedCode(N==1);
+    double Best=1e9;
+    bool Same=true;
+    for (int R=0;R<Reps && Same;R++)
+    {
+      VM.SetMemory(0,&Src[0],Size);
+      Prg.GlobalData.Alloc(VM_FIXEDGLOBALSIZE);
+      memset(&Prg.GlobalData[0],0,VM_FIXEDGLOBALSIZE);
+      VM.SetLowEndianValue((uint *)&Prg.GlobalData[0x1c],Size);
+      memset(Prg.InitR,0,sizeof(Prg.InitR));
+      Prg.InitR[4]=Size;
+      double T=Now();
+      VM.Execute(&Prg);
+      if ((T=Now()-T)<Best)
+        Best=T;
+      Same=Prg.FilteredDataSize==Size && memcmp(Prg.FilteredData,&Ref[0],Size)==0;
+    }
+    if (!Same)
+    {
+      fprintf(stderr,"vm %s: output differs from the C loop\n",Names[N]);
+      Errors++;
+      continue;
+    }
+    printf("vm %s: %u bytes in %.2f ms, %.1f M commands/s\n",Names[N],Size,
+           Best*1e3,(double)Size*LoopCmds/Best/1e6);
+  }
+  return(Errors);
+}
+
+
+static int BenchAES(int Argc,char *Argv[])
+{
+  const size_t Size=0x100000;
+  Array<byte> Src(Size),Dest(Size),Ref(Size);
+  byte Key[16],InitV[16];
+  uint Seed=1;
+  for (size_t I=0;I<Size;I++)
+    Src[I]=byte((Seed=Seed*1103515245+12345)>>16);
+  for (int I=0;I<16;I++)
+  {
+    Key[I]=byte(I*17);
+    InitV[I]=byte(I*29);
+  }
+  const char *Names[]={"tables","aes-ni"};
+#ifdef USE_SSE
+  const bool Detected=_AES_NI;
+  const int Count=Detected ? 2:1;
+#else
+  const int Count=1;
+#endif
+  int Errors=0;
+  for (int N=0;N<Count;N++)
+  {
+#ifdef USE_SSE
+    _AES_NI=N==1;
+#endif
+    Rijndael AES;
+    double Best=1e9;
+    for (int R=0;R<Reps;R++)
+    {
+      AES.init(Rijndael::Decrypt,Key,InitV);
+      double T=Now();
+      AES.blockDecrypt(&Src[0],Size,&Dest[0]);
+      if ((T=Now()-T)<Best)
+        Best=T;
+    }
+    bool Same=true;
+    if (N==0)
+      memcpy(&Ref[0],&Dest[0],Size);
+    else
+      Same=memcmp(&Ref[0],&Dest[0],Size)==0;
+    if (!Same)
+      Errors++;
+    printf("aes %-7s %7.1f MB/s%s\n",Names[N],Size/Best/1e6,
+           Same ? "":"  differs from the tables");
+  }
+#ifdef USE_SSE
+  _AES_NI=Detected;
+#endif
+  return(Errors);
+}
+
+
+static int BenchRS(int Argc,char *Argv[])
+{
+  // Volumes as recvol.cpp has them, data ones first, and which are lost.
+  const int DataFiles=10,RecFiles=3,TotalFiles=DataFiles+RecFiles;
+  int Erasures[]={1,4,11};
+  const int EraSize=ASIZE(Erasures);
+  const size_t Size=0x100000;
+
+  Array<byte> Orig(TotalFiles*Size),Buf(TotalFiles*Size);
+  uint Seed=1;
+  for (size_t I=0;I<DataFiles*Size;I++)
+    Orig[I]=byte((Seed=Seed*1103515245+12345)>>16);
+  RSCoder RSC;
+  RSC.Init(RecFiles);
+  for (size_t I=0;I<Size;I++)
+  {
+    byte Data[TotalFiles];
+    for (int J=0;J<DataFiles;J++)
+      Data[J]=Orig[J*Size+I];
+    RSC.Encode(Data,DataFiles,Data+DataFiles);
+    for (int J=DataFiles;J<TotalFiles;J++)
+      Orig[J*Size+I]=Data[J];
+  }
+
+  int Errors=0;
+  double Best=1e9;
+  bool Same=true;
+  for (int R=0;R<Reps && Same;R++)
+  {
+    memcpy(&Buf[0],&Orig[0],TotalFiles*Size);
+    for (int I=0;I<EraSize;I++)
+      memset(&Buf[Erasures[I]*Size],0,Size);
+    double T=Now();
+    RSC.Init(RecFiles);
+    for (size_t I=0;I<Size;I++)
+    {
+      byte Data[TotalFiles];
+      for (int J=0;J<TotalFiles;J++)
+        Data[J]=Buf[J*Size+I];
+      RSC.Decode(Data,TotalFiles,Erasures,EraSize);
+      for (int J=0;J<EraSize;J++)
+        Buf[Erasures[J]*Size+I]=Data[Erasures[J]];
+    }
+    if ((T=Now()-T)<Best)
+      Best=T;
+    Same=memcmp(&Buf[0],&Orig[0],TotalFiles*Size)==0;
+  }
+  if (!Same)
+    Errors++;
+  printf("rs decode         %7.1f MB/s%s\n",TotalFiles*Size/Best/1e6,
+         Same ? "":"  bad rebuild");
+
+  const char *LevelNames[]={"scalar","ssse3","avx2"};
+#ifdef USE_SSE
+  const SSE_VERSION Levels[]={SSE_NONE,SSE_SSSE3,SSE_AVX2};
+  const SSE_VERSION Detected=_SSE_Version;
+  const uint LevelCount=ASIZE(Levels);
+#else
+  const uint LevelCount=1;
+#endif
+  for (uint L=0;L<LevelCount;L++)
+  {
+#ifdef USE_SSE
+    if (Levels[L]>Detected)
+      break;
+    _SSE_Version=Levels[L];
+#endif
+    Best=1e9;
+    Same=true;
+    for (int R=0;R<Reps && Same;R++)
+    {
+      memcpy(&Buf[0],&Orig[0],TotalFiles*Size);
+      for (int I=0;I<EraSize;I++)
+        memset(&Buf[Erasures[I]*Size],0,Size);
+      double T=Now();
+      byte Matrix[EraSize*TotalFiles];
+      RSC.Init(RecFiles);
+      RSC.DecodeMatrix(TotalFiles,Erasures,EraSize,Matrix);
+      for (int I=0;I<EraSize;I++)
+        for (int J=0;J<TotalFiles;J++)
+          RSC.MulAdd(&Buf[Erasures[I]*Size],&Buf[J*Size],Size,Matrix[I*TotalFiles+J]);
+      if ((T=Now()-T)<Best)
+        Best=T;
+      Same=memcmp(&Buf[0],&Orig[0],TotalFiles*Size)==0;
+    }
+    if (!Same)
+      Errors++;
+    printf("rs muladd %-7s %7.1f MB/s%s\n",LevelNames[L],TotalFiles*Size/Best/1e6,
+           Same ? "":"  bad rebuild");
+  }
+#ifdef USE_SSE
+  _SSE_Version=Detected;
+#endif
+  return(Errors);
+}
+
+
+static struct BenchMode
+{
+  const char *Name;
+  const char *Args;
+  int (*Run)(int Argc,char *Argv[]);
+} Modes[]={
+  {"list","archive...",BenchList},
+  {"unpack","archive...",BenchUnpack},
+  {"filter","file",BenchFilter},
+  {"vm","",BenchVM},
+  {"aes","",BenchAES},
+  {"rs","",BenchRS},
+};
+
+
+int main(int argc,char *argv[])
+{
+  int Arg=1;
+  if (argc>2 && strcmp(argv[1],"-n")==0)
+  {
+    Reps=Max(atoi(argv[2]),1);
+    Arg=3;
+  }
+  for (size_t I=0;Arg<argc && I<ASIZE(Modes);I++)
+    if (strcmp(argv[Arg],Modes[I].Name)==0)
+      return(Modes[I].Run(argc-Arg-1,argv+Arg+1)==0 ? 0:1);
+  fprintf(stderr,"usage: %s [-n reps] mode args...\n",argv[0]);
+  for (size_t I=0;I<ASIZE(Modes);I++)
+    fprintf(stderr,"  %s %s\n",Modes[I].Name,Modes[I].Args);
+  return(1);
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "dll.hpp"
+
+/*
+ * Stress test for the unrar library's thread safety.  Every thread tests
+ * each archive given in turn, starting at a different one so that both the
+ * same and different archives are unpacked at once, each on its own
+ * handle.  Members go through RAR_TEST, so their CRCs are checked, and
+ * every thread has to see the same number of bytes.  Build with
+ * -DFILESET_TSAN=ON to run it under ThreadSanitizer.
+ */
+#define RARSTRESS_MAX_THREADS	64
+
+struct rarstress_thread {
+	pthread_t	thread;
+	int		id;
+	long long	bytes;
+	int		errors;
+};
+
+static char	**archives;
+static int	narchives;
+static int	rounds = 4;
+static char	*password;
+
+static int CALLBACK
+rarstress_callback(unsigned int msg, long user, long p1, long p2)
+{
+	switch (msg) {
+	case UCM_CHANGEVOLUME:
+		return p2 == RAR_VOL_NOTIFY ? 1 : -1;
+	case UCM_PROCESSDATA:
+		*(long long *)user += p2;
+		return 1;
+	case UCM_NEEDPASSWORD:
+		if (password == NULL) {
+			return -1;
+		}
+		strncpy((char *)p1, password, p2 - 1);
+		((char *)p1)[p2 - 1] = '\0';
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Test every member of path once.  Returns the number of failures.
+ */
+static int
+rarstress_test(char *path, long long *bytes)
+{
+	struct RAROpenArchiveDataEx	in;
+	struct RARHeaderDataEx		hdr;
+	HANDLE				rararc;
+	int				status, errors = 0;
+
+	memset(&in, 0, sizeof(in));
+	in.ArcName = path;
+	in.OpenMode = RAR_OM_EXTRACT;
+	in.Callback = rarstress_callback;
+	in.UserData = (long)bytes;
+	if ((rararc = RAROpenArchiveEx(&in)) == NULL) {
+		fprintf(stderr, "%s: open failed (%d)\n", path, in.OpenResult);
+		return 1;
+	}
+	while ((status = RARReadHeaderEx(rararc, &hdr)) == 0) {
+		if ((status = RARProcessFile(rararc, RAR_TEST, NULL, NULL)) != 0) {
+			fprintf(stderr, "%s: %s failed (%d)\n", path, hdr.FileName, status);
+			errors++;
+		}
+	}
+	if (status != ERAR_END_ARCHIVE) {
+		fprintf(stderr, "%s: bad header (%d)\n", path, status);
+		errors++;
+	}
+	RARCloseArchive(rararc);
+
+	return errors;
+}
+
+static void *
+rarstress_worker(void *arg)
+{
+	struct rarstress_thread *t = arg;
+	int round, i;
+
+	for (round = 0; round < rounds; round++) {
+		for (i = 0; i < narchives; i++) {
+			t->errors += rarstress_test(archives[(t->id + i) % narchives], &t->bytes);
+		}
+	}
+
+	return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct rarstress_thread	threads[RARSTRESS_MAX_THREADS];
+	int			nthreads = 8;
+	int			errors = 0;
+	int			opt, i;
+
+	while ((opt = getopt(argc, argv, "n:p:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 'p':
+			password = optarg;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t threads] [-n rounds] [-p password] archive...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind == argc || nthreads < 1 || nthreads > RARSTRESS_MAX_THREADS) {
+		fprintf(stderr, "usage: %s [-t threads] [-n rounds] [-p password] archive...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	archives = argv + optind;
+	narchives = argc - optind;
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].id = i;
+		threads[i].bytes = 0;
+		threads[i].errors = 0;
+		if (pthread_create(&threads[i].thread, NULL, rarstress_worker, &threads[i]) != 0) {
+			fprintf(stderr, "couldn't start thread %d\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		errors += threads[i].errors;
+		if (threads[i].bytes != threads[0].bytes) {
+			fprintf(stderr, "thread %d unpacked %lld bytes, thread 0 %lld\n",
+			    i, threads[i].bytes, threads[0].bytes);
+			errors++;
+		}
+	}
+	fprintf(stdout, "%d threads, %d rounds of %d archives: %lld bytes each, %d errors\n",
+	    nthreads, rounds, narchives, threads[0].bytes, errors);
+
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
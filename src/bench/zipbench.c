@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.c"
+
+/*
+ * Inflate benchmark.  Each file given is deflated with tdefl at -l level,
+ * then inflated -n times both by tinfl_decompress_mem_to_mem(), which
+ * takes the whole-buffer fast path, and by tinfl_decompress() through a
+ * wrapping 32KB dictionary, which is the byte-at-a-time state machine
+ * streaming callers get.  The two outputs have to match the input.
+ */
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *
+load(char *path, size_t *size)
+{
+	FILE		*in;
+	unsigned char	*buf;
+	long		len;
+
+	if ((in = fopen(path, "rb")) == NULL) {
+		return NULL;
+	}
+	fseek(in, 0, SEEK_END);
+	len = ftell(in);
+	rewind(in);
+	if ((buf = malloc(len > 0 ? len : 1)) != NULL && fread(buf, 1, len, in) != (size_t)len) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(in);
+	*size = len;
+
+	return buf;
+}
+
+/*
+ * Inflate src the way a streaming reader does, 32KB of output at a time,
+ * copying each piece to out.  Returns the size of the output, or -1 if the
+ * stream is bad or inflates to more than out_size.
+ */
+static long
+inflate_stream(const unsigned char *src, size_t src_len, unsigned char *dict, unsigned char *out, size_t out_size)
+{
+	tinfl_decompressor	inflator;
+	tinfl_status		status;
+	size_t			dict_ofs = 0;
+	long			out_len = 0;
+
+	tinfl_init(&inflator);
+	do {
+		size_t in_bytes = src_len, out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+
+		status = tinfl_decompress(&inflator, src, &in_bytes, dict, dict + dict_ofs, &out_bytes, 0);
+		src += in_bytes;
+		src_len -= in_bytes;
+		if (out_len + out_bytes > out_size) {
+			return -1;
+		}
+		memcpy(out + out_len, dict + dict_ofs, out_bytes);
+		out_len += out_bytes;
+		dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+	} while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+	return status == TINFL_STATUS_DONE ? out_len : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	level = 6, reps = 20;
+	int	errors = 0;
+	int	opt, i, r;
+
+	while ((opt = getopt(argc, argv, "l:n:")) != -1) {
+		switch (opt) {
+		case 'l':
+			level = atoi(optarg);
+			break;
+		case 'n':
+			reps = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l level] [-n reps] file...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind == argc || reps < 1) {
+		fprintf(stderr, "usage: %s [-l level] [-n reps] file...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = optind; i < argc; i++) {
+		unsigned char	*in, *packed, *out, *dict;
+		size_t		in_len, packed_len, out_len;
+		long		stream_len;
+		double		t, whole = 1e9, stream = 1e9;
+
+		if ((in = load(argv[i], &in_len)) == NULL) {
+			fprintf(stderr, "%s: couldn't read\n", argv[i]);
+			errors++;
+			continue;
+		}
+		packed = tdefl_compress_mem_to_heap(in, in_len, &packed_len,
+		    tdefl_create_comp_flags_from_zip_params(level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+		out = malloc(in_len + 1);
+		dict = malloc(TINFL_LZ_DICT_SIZE);
+		if (packed == NULL || out == NULL || dict == NULL) {
+			fprintf(stderr, "%s: out of memory\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		for (r = 0; r < reps; r++) {
+			t = now();
+			out_len = tinfl_decompress_mem_to_mem(out, in_len + 1, packed, packed_len, 0);
+			if ((t = now() - t) < whole) {
+				whole = t;
+			}
+			if (out_len != in_len || memcmp(out, in, in_len) != 0) {
+				fprintf(stderr, "%s: whole-buffer output differs\n", argv[i]);
+				errors++;
+				break;
+			}
+			memset(out, 0, in_len);
+			t = now();
+			stream_len = inflate_stream(packed, packed_len, dict, out, in_len);
+			if ((t = now() - t) < stream) {
+				stream = t;
+			}
+			if (stream_len != (long)in_len || memcmp(out, in, in_len) != 0) {
+				fprintf(stderr, "%s: streamed output differs\n", argv[i]);
+				errors++;
+				break;
+			}
+		}
+		fprintf(stdout, "%s: %zu -> %zu bytes, whole-buffer %.1f MB/s, streamed %.1f MB/s\n",
+		    argv[i], in_len, packed_len, in_len / whole / 1e6, in_len / stream / 1e6);
+
+		free(in);
+		free(packed);
+		free(out);
+		free(dict);
+	}
+
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,6 +1,8 @@
 #ifndef _FILESET_H_
 #define _FILESET_H_
 
+#include <signal.h>
+
 #define MINIZ_HEADER_FILE_ONLY
 
 #include "miniz.c"
@@ -22,6 +24,10 @@
 #define ZIP 32		// Put hunted files in a zip, not a dir
 #define DELETE 64	// Move found files, don't copy
 #define ONLY_DELETE 128	// Don't try to move, only delete if DELETE is set
+// Deflate level for hunted files put in a zip, 0 stores them
+#define LEVEL(x) (((x) & 0xf) << 8)
+#define GET_LEVEL(mode) (((mode) >> 8) & 0xf)
+#define DEEP 4096	// Unpack zip and rar members and check their CRCs
 
 #define CREATE_COLLECTIONS \
 "CREATE TABLE IF NOT EXISTS collections (id INTEGER PRIMARY KEY AUTOINCREMENT," \
@@ -47,6 +53,13 @@
 				  "sha1 CHARACTER(40)," \
 				  "comment VARCHAR," \
 				  "found INTEGER DEFAULT 0)"
+// Keys derived from rar passwords, by an HMAC of the password and salt
+// keyed with the secret in rarsecret
+#define CREATE_RARKEYS \
+"CREATE TABLE IF NOT EXISTS rarkeys (id BLOB PRIMARY KEY," \
+				    "key BLOB)"
+#define CREATE_RARSECRET \
+"CREATE TABLE IF NOT EXISTS rarsecret (secret BLOB)"
 
 #define SQL_INSERT(db, ...) { \
 	char *query = sqlite3_mprintf(__VA_ARGS__); \
@@ -77,14 +90,51 @@ struct zipinfo {
 
 struct rarinfo {
 	HANDLE			rar;
-	struct RARHeaderDataEx	*hdr;
+	struct RARHeaderDataSlim	*hdr;
+};
+
+/*
+ * A rar member to be unpacked on a worker thread by rar_parallel().  The
+ * caller fills in where it is, the worker the rest.
+ */
+struct rarpart {
+	unsigned long long	pos;	// HeaderPos from the header pass
+	unsigned int		crc;
+	int			id;	// for the caller
+	unsigned char		*data;	// unpacked member, if kept
+	unsigned long long	size;
+	char			*name;
+	int			status;	// 0 or the ERAR_ code
+	int			done;
 };
 
+// Rar members up to this size are unpacked into memory as a whole
+#define RAR_WHOLE_MAX	(64 * 1024 * 1024)
+
+extern volatile sig_atomic_t interrupted;
+
 mz_zip_archive *open_zip(char *, int);
-int CALLBACK rar_extract_to_mem(unsigned int, long, long, long);
+mz_zip_archive *zip_writer_get(char *);
+void zip_writer_defer_unlink(mz_zip_archive *, char *);
+void zip_writer_release(char *);
+void zip_writer_close_all(void);
+void *pdeflate(const void *, size_t, int, size_t *, mz_uint32 *);
+int zip_add_mem(mz_zip_archive *, char *, const void *, size_t, int);
+
+int zip_deep_verify(char *, int);
+
+int CALLBACK rar_callback(unsigned int, long, long, long);
+unsigned char *rar_extract_to_mem(HANDLE, struct RARHeaderDataSlim *);
+int rar_extract_to_zip(HANDLE, struct RARHeaderDataSlim *, mz_zip_archive *, char *, int);
+int rar_load_passwords(char *);
+int rar_set_key_db(sqlite3 *);
 HANDLE rar_open(char *, int);
+HANDLE rar_open_pool(HANDLE, char *, int);
+int rar_restore(char *);
 void rar_close(HANDLE);
 int rar_get_num_files(HANDLE);
+int rar_parallel(char *, struct rarpart *, int, int, void (*)(struct rarpart *, void *), void *);
+int rar_deep_verify(char *, int);
 
 int load_csv(char *, char *, sqlite3 *);
 int load_cmpro_dat(char *, char *, sqlite3 *);
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pwd.h>
 #include <errno.h>
 #include <sys/stat.h>
@@ -23,9 +24,16 @@ main(int argc, char **argv)
 	int	zip_flag = 0;
 	int	setup_flag = 0;
 	int	find_flags = 0;
+	int	key_flag = 0;
 	FILE *in;
+	struct option long_opts[] = {
+		{"deep", no_argument, NULL, 'D'},
+		{"passwords", required_argument, NULL, 'p'},
+		{"keep-keys", no_argument, NULL, 'k'},
+		{NULL, 0, NULL, 0}
+	};
 
-	while ((opt = getopt(argc, argv, "c:d:em:r:svz")) != -1) {
+	while ((opt = getopt_long(argc, argv, "c:d:ekm:p:r:svzZ:", long_opts, NULL)) != -1) {
 		switch (opt) {
 		case 'c':
 			dat_flag = CSV;
@@ -34,13 +42,24 @@ main(int argc, char **argv)
 		case 'd':
 			dbname = optarg;
 			break;
+		case 'D':
+			find_flags |= DEEP;
+			break;
 		case 'e':
 			find_flags |= DELETE;
 			break;
+		case 'k':
+			key_flag = 1;
+			break;
 		case 'm':
 			dat_flag = CMPRO;
 			crcname = optarg;
 			break;
+		case 'p':
+			if (rar_load_passwords(optarg) == -1) {
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'r':
 			root = optarg;
 			break;
@@ -53,6 +72,13 @@ main(int argc, char **argv)
 		case 'z':
 			find_flags |= ZIP;
 			break;
+		case 'Z':
+			if (optarg[0] < '0' || optarg[0] > '9' || optarg[1] != '\0') {
+				fprintf(stderr, "error: -Z takes a compression level from 0 to 9\n");
+				return EXIT_FAILURE;
+			}
+			find_flags |= ZIP | LEVEL(optarg[0] - '0');
+			break;
 		}
 	}
 
@@ -95,6 +121,21 @@ main(int argc, char **argv)
 		sqlite3_close(db);
 		return EXIT_FAILURE;
 	}
+	if (sqlite3_exec(db, CREATE_RARKEYS, NULL, 0, &errmsg) != SQLITE_OK) {
+		fprintf(stderr, "SQL error: %s\n", errmsg);
+		sqlite3_free(errmsg);
+		sqlite3_close(db);
+		return EXIT_FAILURE;
+	}
+	if (sqlite3_exec(db, CREATE_RARSECRET, NULL, 0, &errmsg) != SQLITE_OK) {
+		fprintf(stderr, "SQL error: %s\n", errmsg);
+		sqlite3_free(errmsg);
+		sqlite3_close(db);
+		return EXIT_FAILURE;
+	}
+	if (key_flag && rar_set_key_db(db) == -1) {
+		fprintf(stderr, "error: couldn't set up the rar key store\n");
+	}
 	sqlite3_exec(db, "PRAGMA synchronous = OFF", NULL, NULL, &errmsg);
 	sqlite3_exec(db, "PRAGMA journal_mode = MEMORY", NULL, NULL, &errmsg);
 
@@ -165,6 +206,7 @@ main(int argc, char **argv)
 		sqlite3_free(query);
 	} else if (!strcmp(argv[optind], "hunt")) {
 		find(db, ".", HUNT | find_flags);
+		zip_writer_close_all();
 	} else if (!strcmp(argv[optind], "list")) {
 		char *query = sqlite3_mprintf("SELECT c.name, c.root, (SELECT COUNT(*) FROM sets WHERE collection_id=c.id), COUNT(f.id), SUM(f.found) FROM collections c, sets s, files f WHERE c.id = s.collection_id AND s.id = f.set_id group by c.id");
 		char **table, *errmsg;
@@ -186,6 +228,11 @@ main(int argc, char **argv)
 		fprintf(stderr, "Unknown command %s.\n"
 			"search - search local tree for files in db.\n"
 			"verify - verify files in collection directories.\n"
+			"         --deep also unpacks zip and rar members and checks their crcs.\n"
+			"-p file - passwords to try on encrypted rars, one per line.\n"
+			"-k      - keep keys derived from those passwords in the db, so\n"
+			"          they aren't derived again.  Anyone with the db can\n"
+			"          then test guesses at the passwords quickly.\n"
 			"hunt   - search local tree for files and move"
 			"         them into collections", argv[optind]);
 	}
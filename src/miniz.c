@@ -616,10 +616,33 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
 mz_bool mz_zip_writer_add_file(mz_zip_archive *pZip, const char *pArchive_name, const char *pSrc_filename, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags);
 #endif
 
+// Adds an entry whose data is handed over in pieces, so it never has to be in memory all at once. Call mz_zip_writer_add_stream_begin(),
+// then mz_zip_writer_add_stream_write() for each piece, then mz_zip_writer_add_stream_end() to write the entry's headers, or
+// mz_zip_writer_add_stream_abort() to drop it. Nothing else may be added to pZip in between. pStream must not move and pArchive_name
+// must stay valid until the entry is ended or aborted. level_and_flags is as for mz_zip_writer_add_mem(), without MZ_ZIP_FLAG_COMPRESSED_DATA.
+typedef struct
+{
+  mz_zip_archive *m_pZip;
+  const char *m_pArchive_name;
+  void *m_pComp;
+  mz_uint64 m_local_dir_header_ofs, m_cur_archive_file_ofs, m_comp_size, m_uncomp_size;
+  mz_uint32 m_crc32;
+  mz_uint16 m_method, m_dos_time, m_dos_date;
+} mz_zip_writer_stream;
+
+mz_bool mz_zip_writer_add_stream_begin(mz_zip_archive *pZip, mz_zip_writer_stream *pStream, const char *pArchive_name, mz_uint level_and_flags);
+mz_bool mz_zip_writer_add_stream_write(mz_zip_writer_stream *pStream, const void *pBuf, size_t buf_size);
+mz_bool mz_zip_writer_add_stream_end(mz_zip_writer_stream *pStream);
+void mz_zip_writer_add_stream_abort(mz_zip_writer_stream *pStream);
+
 // Adds a file to an archive by fully cloning the data from another archive.
 // This function fully clones the source file's compressed data (no recompression), along with its full filename, extra data, and comment fields.
 mz_bool mz_zip_writer_add_from_zip_reader(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index);
 
+// Same as mz_zip_writer_add_from_zip_reader(), but stores the entry under pArchive_name. A fresh local header is written using the source's
+// CRC-32, sizes, method and time from its central directory; only the compressed data is copied. Extra data and comments are not carried over.
+mz_bool mz_zip_writer_add_from_zip_reader_as(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index, const char *pArchive_name);
+
 // Finalizes the archive by writing the central directory records followed by the end of central directory record.
 // After an archive is finalized, the only valid call on the mz_zip_archive struct is mz_zip_writer_end().
 // An archive must be manually finalized by calling this function for it to be valid.
@@ -861,6 +884,11 @@ typedef struct
 // flags: See the above enums (TDEFL_HUFFMAN_ONLY, TDEFL_WRITE_ZLIB_HEADER, etc.)
 tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
 
+// Primes the compressor's dictionary with data that precedes the input (only the last TDEFL_LZ_DICT_SIZE bytes are used), like zlib's deflateSetDictionary()
+// on a raw stream. Must be called right after tdefl_init(). Nothing is output for the dictionary itself, so the decompressor must already hold it as history,
+// e.g. because it's the tail of the previous part of a stream that was ended with TDEFL_SYNC_FLUSH.
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_size);
+
 // Compresses a block of data, consuming as much of the specified input buffer as possible, and writing as much compressed data to the specified output buffer as possible.
 tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pIn_buf_size, void *pOut_buf, size_t *pOut_buf_size, tdefl_flush flush);
 
@@ -1381,6 +1409,287 @@ const char *mz_error(int err)
     code_len = TINFL_FAST_LOOKUP_BITS; do { temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0); \
   } sym = temp; bit_buf >>= code_len; num_bits -= code_len; } MZ_MACRO_END
 
+// ------------------- Whole-buffer fast path for tinfl_decompress()
+// When the entire raw deflate stream and a non-wrapping output buffer are both in memory, tinfl_decompress() first tries this decoder. It keeps a 64-bit
+// bit buffer that is refilled with one unaligned load, decodes through 11-bit literal/length and 8-bit distance tables (with subtables for longer codes),
+// resolves a length's base and extra bits count in the same lookup, packs two short literals into a single table entry, and copies matches a word at a time.
+// It never reports partial progress: on any problem (bad data, output buffer too small) it gives up and the regular coroutine decodes the stream from scratch.
+
+enum
+{
+  TINFL_FAST_LITLEN_BITS = 11, TINFL_FAST_DIST_BITS = 8, TINFL_FAST_PRECODE_BITS = 7,
+  TINFL_FAST_LITLEN_ENOUGH = (1 << TINFL_FAST_LITLEN_BITS) + TINFL_MAX_HUFF_SYMBOLS_0 * 16,
+  TINFL_FAST_DIST_ENOUGH = (1 << TINFL_FAST_DIST_BITS) + TINFL_MAX_HUFF_SYMBOLS_1 * 128
+};
+
+// Table entries: bits 0-4 bits to consume, 5-8 extra bits (or subtable bits), 9-11 kind, 16-31 payload.
+enum { TINFL_FAST_LIT = 0, TINFL_FAST_LIT2 = 1, TINFL_FAST_LEN = 2, TINFL_FAST_EOB = 3, TINFL_FAST_SUB = 4, TINFL_FAST_BAD = 5, TINFL_FAST_DIST = 6 };
+#define TINFL_FAST_ENTRY(kind, extra, payload) (((mz_uint32)(payload) << 16) | ((mz_uint32)(kind) << 9) | ((mz_uint32)(extra) << 5))
+#define TINFL_FAST_KIND(e) (((e) >> 9) & 7)
+#define TINFL_FAST_EXTRA(e) (((e) >> 5) & 15)
+#define TINFL_FAST_USED(e) ((e) & 31)
+#define TINFL_FAST_PAYLOAD(e) ((e) >> 16)
+
+static const mz_uint16 s_tinfl_fast_length_base[29] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258 };
+static const mz_uint8 s_tinfl_fast_length_extra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const mz_uint16 s_tinfl_fast_dist_base[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const mz_uint8 s_tinfl_fast_dist_extra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+static MZ_FORCEINLINE mz_uint64 tinfl_fast_read_le64(const mz_uint8 *p)
+{
+#if MINIZ_LITTLE_ENDIAN
+  mz_uint64 v; memcpy(&v, p, sizeof(v)); return v;
+#else
+  return (mz_uint64)MZ_READ_LE32(p) | ((mz_uint64)MZ_READ_LE32(p + 4) << 32);
+#endif
+}
+
+// Builds a canonical Huffman decode table for pLens[0..num_syms). pSym_entries gives each symbol's entry minus the bit count. Codes longer than table_bits
+// go to subtables placed after the primary table. Incomplete codes are allowed (their unused entries decode as TINFL_FAST_BAD); over-subscribed ones are not.
+static mz_bool tinfl_fast_build_table(mz_uint32 *pTable, mz_uint table_bits, mz_uint max_entries, const mz_uint8 *pLens, mz_uint num_syms, const mz_uint32 *pSym_entries)
+{
+  mz_uint count[16], next_code[17], code[16], sym, len, i, pos;
+  mz_uint8 sub_bits[1 << TINFL_FAST_LITLEN_BITS]; mz_uint16 sub_ofs[1 << TINFL_FAST_LITLEN_BITS];
+  int left = 1;
+  const mz_uint primary_size = 1U << table_bits, mask = primary_size - 1;
+  const mz_uint32 bad = TINFL_FAST_ENTRY(TINFL_FAST_BAD, 0, 0);
+
+  MZ_CLEAR_OBJ(count);
+  for (sym = 0; sym < num_syms; sym++) count[pLens[sym]]++;
+  count[0] = 0;
+  for (len = 1; len < 16; len++) { left = (left << 1) - (int)count[len]; if (left < 0) return MZ_FALSE; }
+  next_code[1] = 0;
+  for (len = 1; len < 16; len++) next_code[len + 1] = (next_code[len] + count[len]) << 1;
+
+  for (i = 0; i < primary_size; i++) pTable[i] = bad;
+  memset(sub_bits, 0, primary_size);
+
+  // First pass: size the subtable behind every primary slot that long codes share.
+  memcpy(code, next_code, sizeof(code));
+  for (sym = 0; sym < num_syms; sym++)
+  {
+    mz_uint rev = 0, c, l;
+    if ((len = pLens[sym]) == 0) continue;
+    c = code[len]++;
+    if (len <= table_bits) continue;
+    for (l = 0; l < len; l++, c >>= 1) rev = (rev << 1) | (c & 1);
+    if (len - table_bits > sub_bits[rev & mask]) sub_bits[rev & mask] = (mz_uint8)(len - table_bits);
+  }
+  for (i = 0, pos = primary_size; i < primary_size; i++)
+  {
+    mz_uint j, n;
+    if (!sub_bits[i]) continue;
+    n = 1U << sub_bits[i];
+    if (pos + n > max_entries) return MZ_FALSE;
+    sub_ofs[i] = (mz_uint16)pos;
+    pTable[i] = TINFL_FAST_ENTRY(TINFL_FAST_SUB, sub_bits[i], pos) | table_bits;
+    for (j = 0; j < n; j++) pTable[pos + j] = bad;
+    pos += n;
+  }
+
+  // Second pass: replicate each code across every slot whose low bits match it.
+  memcpy(code, next_code, sizeof(code));
+  for (sym = 0; sym < num_syms; sym++)
+  {
+    mz_uint rev = 0, c, l;
+    if ((len = pLens[sym]) == 0) continue;
+    c = code[len]++;
+    for (l = 0; l < len; l++, c >>= 1) rev = (rev << 1) | (c & 1);
+    if (len <= table_bits)
+    {
+      for (i = rev; i < primary_size; i += 1U << len) pTable[i] = pSym_entries[sym] | len;
+    }
+    else
+    {
+      mz_uint sub_len = len - table_bits, base = sub_ofs[rev & mask];
+      for (i = rev >> table_bits; i < (1U << sub_bits[rev & mask]); i += 1U << sub_len) pTable[base + i] = pSym_entries[sym] | sub_len;
+    }
+  }
+  return MZ_TRUE;
+}
+
+static mz_bool tinfl_fast_build_litlen_table(mz_uint32 *pTable, const mz_uint8 *pLens, mz_uint num_syms)
+{
+  mz_uint32 sym_entries[TINFL_MAX_HUFF_SYMBOLS_0], primary[1 << TINFL_FAST_LITLEN_BITS];
+  mz_uint i;
+  for (i = 0; i < 256; i++) sym_entries[i] = TINFL_FAST_ENTRY(TINFL_FAST_LIT, 0, i);
+  sym_entries[256] = TINFL_FAST_ENTRY(TINFL_FAST_EOB, 0, 0);
+  for (i = 257; i < 286; i++) sym_entries[i] = TINFL_FAST_ENTRY(TINFL_FAST_LEN, s_tinfl_fast_length_extra[i - 257], s_tinfl_fast_length_base[i - 257]);
+  sym_entries[286] = sym_entries[287] = TINFL_FAST_ENTRY(TINFL_FAST_BAD, 0, 0);
+  if (!tinfl_fast_build_table(pTable, TINFL_FAST_LITLEN_BITS, TINFL_FAST_LITLEN_ENOUGH, pLens, num_syms, sym_entries))
+    return MZ_FALSE;
+
+  // Pack a second literal into every literal slot whose leftover bits already fully determine the next code.
+  memcpy(primary, pTable, sizeof(primary));
+  for (i = 0; i < (1U << TINFL_FAST_LITLEN_BITS); i++)
+  {
+    mz_uint32 e = primary[i], e2; mz_uint len1 = TINFL_FAST_USED(e);
+    if ((TINFL_FAST_KIND(e) != TINFL_FAST_LIT) || (len1 >= TINFL_FAST_LITLEN_BITS)) continue;
+    e2 = primary[i >> len1];
+    if ((TINFL_FAST_KIND(e2) == TINFL_FAST_LIT) && (TINFL_FAST_USED(e2) <= TINFL_FAST_LITLEN_BITS - len1))
+      pTable[i] = TINFL_FAST_ENTRY(TINFL_FAST_LIT2, 0, TINFL_FAST_PAYLOAD(e) | (TINFL_FAST_PAYLOAD(e2) << 8)) | (len1 + TINFL_FAST_USED(e2));
+  }
+  return MZ_TRUE;
+}
+
+static mz_bool tinfl_fast_build_dist_table(mz_uint32 *pTable, const mz_uint8 *pLens, mz_uint num_syms)
+{
+  mz_uint32 sym_entries[TINFL_MAX_HUFF_SYMBOLS_1];
+  mz_uint i;
+  for (i = 0; i < 30; i++) sym_entries[i] = TINFL_FAST_ENTRY(TINFL_FAST_DIST, s_tinfl_fast_dist_extra[i], s_tinfl_fast_dist_base[i]);
+  sym_entries[30] = sym_entries[31] = TINFL_FAST_ENTRY(TINFL_FAST_BAD, 0, 0);
+  return tinfl_fast_build_table(pTable, TINFL_FAST_DIST_BITS, TINFL_FAST_DIST_ENOUGH, pLens, num_syms, sym_entries);
+}
+
+// Keeps at least 56 valid bits in bit_buf. Bits above num_bits may hold copies of upcoming input; they are ORed with the same values on the next refill.
+// Past the end of the input zero bytes are shifted in; consuming any of them means the stream is truncated.
+#define TINFL_FAST_REFILL() do { \
+  if ((pIn_end - pIn) >= 8) { \
+    bit_buf |= tinfl_fast_read_le64(pIn) << num_bits; pIn += (63 - num_bits) >> 3; num_bits |= 56; \
+  } else { \
+    while (num_bits <= 56) { if (pIn < pIn_end) bit_buf |= (mz_uint64)(*pIn++) << num_bits; else if (++overrun > 8) return MZ_FALSE; num_bits += 8; } \
+  } } MZ_MACRO_END
+#define TINFL_FAST_CONSUME(n) do { bit_buf >>= (n); num_bits -= (n); } MZ_MACRO_END
+#define TINFL_FAST_LOOKUP(e, pTable, table_bits) do { \
+  e = pTable[bit_buf & ((1U << (table_bits)) - 1)]; \
+  if (TINFL_FAST_KIND(e) == TINFL_FAST_SUB) { TINFL_FAST_CONSUME(table_bits); e = pTable[TINFL_FAST_PAYLOAD(e) + (bit_buf & ((1U << TINFL_FAST_EXTRA(e)) - 1))]; } \
+  TINFL_FAST_CONSUME(TINFL_FAST_USED(e)); } MZ_MACRO_END
+
+static mz_bool tinfl_decompress_fast(const mz_uint8 *pIn_buf, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size)
+{
+  static const mz_uint8 s_length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+  mz_uint32 litlen_table[TINFL_FAST_LITLEN_ENOUGH], dist_table[TINFL_FAST_DIST_ENOUGH];
+  mz_uint8 lens[TINFL_MAX_HUFF_SYMBOLS_0 + TINFL_MAX_HUFF_SYMBOLS_1];
+  const mz_uint8 *pIn = pIn_buf, *const pIn_end = pIn_buf + *pIn_buf_size;
+  mz_uint8 *pOut = pOut_buf_next, *const pOut_end = pOut_buf_next + *pOut_buf_size;
+  mz_uint64 bit_buf = 0; mz_uint num_bits = 0, overrun = 0, final;
+
+  do
+  {
+    mz_uint type;
+    TINFL_FAST_REFILL();
+    final = (mz_uint)(bit_buf & 1); type = (mz_uint)((bit_buf >> 1) & 3); TINFL_FAST_CONSUME(3);
+
+    if (type == 0)
+    {
+      // Stored block: hand the whole bytes in the bit buffer back to the input, then copy straight through.
+      mz_uint len, nlen;
+      TINFL_FAST_CONSUME(num_bits & 7);
+      if ((num_bits >> 3) < overrun) return MZ_FALSE;
+      pIn -= (num_bits >> 3) - overrun; overrun = 0; bit_buf = 0; num_bits = 0;
+      if ((pIn_end - pIn) < 4) return MZ_FALSE;
+      len = pIn[0] | (pIn[1] << 8); nlen = pIn[2] | (pIn[3] << 8); pIn += 4;
+      if ((len != (~nlen & 0xFFFF)) || ((size_t)(pIn_end - pIn) < len) || ((size_t)(pOut_end - pOut) < len)) return MZ_FALSE;
+      memcpy(pOut, pIn, len); pIn += len; pOut += len;
+      continue;
+    }
+    else if (type == 1)
+    {
+      mz_uint i;
+      for (i = 0; i < 144; i++) lens[i] = 8;
+      for ( ; i < 256; i++) lens[i] = 9;
+      for ( ; i < 280; i++) lens[i] = 7;
+      for ( ; i < 288; i++) lens[i] = 8;
+      for (i = 0; i < 32; i++) lens[288 + i] = 5;
+      if ((!tinfl_fast_build_litlen_table(litlen_table, lens, 288)) || (!tinfl_fast_build_dist_table(dist_table, lens + 288, 32))) return MZ_FALSE;
+    }
+    else if (type == 2)
+    {
+      mz_uint32 precode_table[1 << TINFL_FAST_PRECODE_BITS], precode_entries[19];
+      mz_uint8 precode_lens[19];
+      mz_uint num_litlen, num_dist, num_precode, i, n;
+      num_litlen = (mz_uint)(bit_buf & 31) + 257; num_dist = (mz_uint)((bit_buf >> 5) & 31) + 1; num_precode = (mz_uint)((bit_buf >> 10) & 15) + 4;
+      TINFL_FAST_CONSUME(14);
+      if ((num_litlen > 286) || (num_dist > 30)) return MZ_FALSE;
+      memset(precode_lens, 0, sizeof(precode_lens));
+      for (i = 0; i < num_precode; i++) { TINFL_FAST_REFILL(); precode_lens[s_length_dezigzag[i]] = (mz_uint8)(bit_buf & 7); TINFL_FAST_CONSUME(3); }
+      for (i = 0; i < 19; i++) precode_entries[i] = TINFL_FAST_ENTRY(TINFL_FAST_LIT, 0, i);
+      if (!tinfl_fast_build_table(precode_table, TINFL_FAST_PRECODE_BITS, 1 << TINFL_FAST_PRECODE_BITS, precode_lens, 19, precode_entries)) return MZ_FALSE;
+
+      for (i = 0, n = num_litlen + num_dist; i < n; )
+      {
+        mz_uint32 e; mz_uint sym, rep; mz_uint8 val;
+        TINFL_FAST_REFILL();
+        e = precode_table[bit_buf & ((1U << TINFL_FAST_PRECODE_BITS) - 1)];
+        if (TINFL_FAST_KIND(e) != TINFL_FAST_LIT) return MZ_FALSE;
+        TINFL_FAST_CONSUME(TINFL_FAST_USED(e));
+        if ((sym = TINFL_FAST_PAYLOAD(e)) < 16) { lens[i++] = (mz_uint8)sym; continue; }
+        if (sym == 16) { if (!i) return MZ_FALSE; val = lens[i - 1]; rep = 3 + (mz_uint)(bit_buf & 3); TINFL_FAST_CONSUME(2); }
+        else if (sym == 17) { val = 0; rep = 3 + (mz_uint)(bit_buf & 7); TINFL_FAST_CONSUME(3); }
+        else { val = 0; rep = 11 + (mz_uint)(bit_buf & 127); TINFL_FAST_CONSUME(7); }
+        if (i + rep > n) return MZ_FALSE;
+        memset(lens + i, val, rep); i += rep;
+      }
+      // The litlen and dist lengths are one sequence; split them apart for the table builders.
+      memmove(lens + 288, lens + num_litlen, num_dist);
+      if (!lens[256]) return MZ_FALSE;
+      if ((!tinfl_fast_build_litlen_table(litlen_table, lens, num_litlen)) || (!tinfl_fast_build_dist_table(dist_table, lens + 288, num_dist))) return MZ_FALSE;
+    }
+    else
+      return MZ_FALSE;
+
+    for ( ; ; )
+    {
+      mz_uint32 e; mz_uint len, dist; const mz_uint8 *pSrc;
+      TINFL_FAST_REFILL();
+      TINFL_FAST_LOOKUP(e, litlen_table, TINFL_FAST_LITLEN_BITS);
+      switch (TINFL_FAST_KIND(e))
+      {
+        case TINFL_FAST_LIT:
+          if (pOut >= pOut_end) return MZ_FALSE;
+          *pOut++ = (mz_uint8)TINFL_FAST_PAYLOAD(e);
+          continue;
+        case TINFL_FAST_LIT2:
+          if ((pOut_end - pOut) < 2) return MZ_FALSE;
+          pOut[0] = (mz_uint8)TINFL_FAST_PAYLOAD(e); pOut[1] = (mz_uint8)(TINFL_FAST_PAYLOAD(e) >> 8); pOut += 2;
+          continue;
+        case TINFL_FAST_LEN:
+          break;
+        case TINFL_FAST_EOB:
+          goto block_done;
+        default:
+          return MZ_FALSE;
+      }
+
+      // 56 bits cover the worst case length code, its extra bits, the distance code and its extra bits (15 + 5 + 15 + 13).
+      len = TINFL_FAST_PAYLOAD(e) + (mz_uint)(bit_buf & ((1U << TINFL_FAST_EXTRA(e)) - 1)); TINFL_FAST_CONSUME(TINFL_FAST_EXTRA(e));
+      TINFL_FAST_LOOKUP(e, dist_table, TINFL_FAST_DIST_BITS);
+      if (TINFL_FAST_KIND(e) != TINFL_FAST_DIST) return MZ_FALSE;
+      dist = TINFL_FAST_PAYLOAD(e) + (mz_uint)(bit_buf & ((1U << TINFL_FAST_EXTRA(e)) - 1)); TINFL_FAST_CONSUME(TINFL_FAST_EXTRA(e));
+      if (((size_t)(pOut - pOut_buf_start) < dist) || ((size_t)(pOut_end - pOut) < len)) return MZ_FALSE;
+
+      pSrc = pOut - dist;
+      if (((size_t)(pOut_end - pOut) >= len + 8) && (dist >= 8))
+      {
+        // Eight bytes at a time, possibly writing up to 7 bytes past the match; those are rewritten later or lie beyond the output.
+        mz_uint8 *pEnd = pOut + len;
+        do { memcpy(pOut, pSrc, 8); pOut += 8; pSrc += 8; } while (pOut < pEnd);
+        pOut = pEnd;
+      }
+      else if (dist == 1)
+      {
+        memset(pOut, *pSrc, len); pOut += len;
+      }
+      else
+      {
+        do { *pOut++ = *pSrc++; } while (--len);
+      }
+    }
+block_done:
+    ;
+  } while (!final);
+
+  // Whole bytes still in the bit buffer were never used; give them back.
+  if ((num_bits >> 3) < overrun) return MZ_FALSE;
+  *pIn_buf_size = (size_t)(pIn - pIn_buf) - ((num_bits >> 3) - overrun);
+  *pOut_buf_size = (size_t)(pOut - pOut_buf_next);
+  return MZ_TRUE;
+}
+
+#undef TINFL_FAST_REFILL
+#undef TINFL_FAST_CONSUME
+#undef TINFL_FAST_LOOKUP
+
 tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
 {
   static const int s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
@@ -1398,6 +1707,19 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
   // Ensure the output buffer's size is a power of 2, unless the output buffer is large enough to hold the entire output file (in which case it doesn't matter).
   if (((out_buf_size_mask + 1) & out_buf_size_mask) || (pOut_buf_next < pOut_buf_start)) { *pIn_buf_size = *pOut_buf_size = 0; return TINFL_STATUS_BAD_PARAM; }
 
+  // A fresh raw stream that's entirely in memory, going to a buffer that can hold all of it, can use the whole-buffer decoder.
+  if ((!r->m_state) && ((decomp_flags & (TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | TINFL_FLAG_COMPUTE_ADLER32)) == TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF))
+  {
+    size_t in_buf_size = *pIn_buf_size, out_buf_size = *pOut_buf_size;
+    if (tinfl_decompress_fast(pIn_buf_next, &in_buf_size, pOut_buf_start, pOut_buf_next, &out_buf_size))
+    {
+      // Park the coroutine in its final state (see TINFL_CR_RETURN_FOREVER(34, ...) below) so further calls keep returning DONE.
+      r->m_state = 34; r->m_num_bits = 0; r->m_bit_buf = 0; r->m_dist = r->m_counter = r->m_num_extra = 0; r->m_dist_from_out_buf_start = 0;
+      *pIn_buf_size = in_buf_size; *pOut_buf_size = out_buf_size;
+      return TINFL_STATUS_DONE;
+    }
+  }
+
   num_bits = r->m_num_bits; bit_buf = r->m_bit_buf; dist = r->m_dist; counter = r->m_counter; num_extra = r->m_num_extra; dist_from_out_buf_start = r->m_dist_from_out_buf_start;
   TINFL_CR_BEGIN
 
@@ -2669,6 +2991,45 @@ tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_fun
   return TDEFL_STATUS_OKAY;
 }
 
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_size)
+{
+  const mz_uint8 *pSrc = (const mz_uint8 *)pDict;
+  mz_uint i, n;
+  if ((!d) || (d->m_lookahead_pos) || (d->m_lookahead_size) || (d->m_block_index) || ((dict_size) && (!pDict)))
+    return TDEFL_STATUS_BAD_PARAM;
+  n = (mz_uint)MZ_MIN(dict_size, TDEFL_LZ_DICT_SIZE);
+  pSrc += dict_size - n;
+
+  memcpy(d->m_dict, pSrc, n);
+  memcpy(d->m_dict + TDEFL_LZ_DICT_SIZE, pSrc, MZ_MIN(n, TDEFL_MAX_MATCH_LEN - 1));
+
+  // Insert every position whose trigram lies entirely inside the dictionary, using whichever hash scheme tdefl_compress() will pick.
+#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+  if (((d->m_flags & TDEFL_MAX_PROBES_MASK) == 1) &&
+      ((d->m_flags & TDEFL_GREEDY_PARSING_FLAG) != 0) &&
+      ((d->m_flags & (TDEFL_FILTER_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+  {
+    for (i = 0; i + 2 < n; i++)
+    {
+      mz_uint trigram = pSrc[i] | (pSrc[i + 1] << 8) | (pSrc[i + 2] << 16);
+      mz_uint hash = (trigram ^ (trigram >> (24 - (TDEFL_LZ_HASH_BITS - 8)))) & TDEFL_LEVEL1_HASH_SIZE_MASK;
+      d->m_hash[hash] = (mz_uint16)i;
+    }
+  }
+  else
+#endif // #if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+  {
+    for (i = 0; i + 2 < n; i++)
+    {
+      mz_uint hash = ((pSrc[i] << (TDEFL_LZ_HASH_SHIFT * 2)) ^ (pSrc[i + 1] << TDEFL_LZ_HASH_SHIFT) ^ pSrc[i + 2]) & (TDEFL_LZ_HASH_SIZE - 1);
+      d->m_next[i & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)i;
+    }
+  }
+
+  d->m_lookahead_pos = d->m_lz_code_buf_dict_pos = d->m_dict_size = n;
+  return TDEFL_STATUS_OKAY;
+}
+
 tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d)
 {
   return d->m_prev_return_status;
@@ -4261,6 +4622,162 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
   return MZ_TRUE;
 }
 
+static mz_bool mz_zip_writer_stream_put_buf_callback(const void* pBuf, int len, void *pUser)
+{
+  mz_zip_writer_stream *pStream = (mz_zip_writer_stream *)pUser;
+  mz_zip_archive *pZip = pStream->m_pZip;
+  if ((int)pZip->m_pWrite(pZip->m_pIO_opaque, pStream->m_cur_archive_file_ofs, pBuf, len) != len)
+    return MZ_FALSE;
+  pStream->m_cur_archive_file_ofs += len;
+  pStream->m_comp_size += len;
+  return MZ_TRUE;
+}
+
+mz_bool mz_zip_writer_add_stream_begin(mz_zip_archive *pZip, mz_zip_writer_stream *pStream, const char *pArchive_name, mz_uint level_and_flags)
+{
+  mz_uint level, num_alignment_padding_bytes;
+  size_t archive_name_size;
+  mz_zip_internal_state *pState;
+
+  MZ_CLEAR_OBJ(*pStream);
+  if ((int)level_and_flags < 0)
+    level_and_flags = MZ_DEFAULT_LEVEL;
+  level = level_and_flags & 0xF;
+
+  if ((!pZip) || (!pZip->m_pState) || (pZip->m_zip_mode != MZ_ZIP_MODE_WRITING) || (!pArchive_name) || (pZip->m_total_files == 0xFFFF) || (level > MZ_UBER_COMPRESSION) || (level_and_flags & MZ_ZIP_FLAG_COMPRESSED_DATA))
+    return MZ_FALSE;
+
+  pState = pZip->m_pState;
+
+  if (!mz_zip_writer_validate_archive_name(pArchive_name))
+    return MZ_FALSE;
+
+  archive_name_size = strlen(pArchive_name);
+  // Directories have no data to stream.
+  if ((archive_name_size > 0xFFFF) || ((archive_name_size) && (pArchive_name[archive_name_size - 1] == '/')))
+    return MZ_FALSE;
+
+#ifndef MINIZ_NO_TIME
+  {
+    time_t cur_time; time(&cur_time);
+    mz_zip_time_to_dos_time(cur_time, &pStream->m_dos_time, &pStream->m_dos_date);
+  }
+#endif // #ifndef MINIZ_NO_TIME
+
+  num_alignment_padding_bytes = mz_zip_writer_compute_padding_needed_for_file_alignment(pZip);
+
+  // no zip64 support yet
+  if ((pZip->m_archive_size + num_alignment_padding_bytes + MZ_ZIP_LOCAL_DIR_HEADER_SIZE + MZ_ZIP_CENTRAL_DIR_HEADER_SIZE + archive_name_size) > 0xFFFFFFFF)
+    return MZ_FALSE;
+
+  if ((!mz_zip_array_ensure_room(pZip, &pState->m_central_dir, MZ_ZIP_CENTRAL_DIR_HEADER_SIZE + archive_name_size)) || (!mz_zip_array_ensure_room(pZip, &pState->m_central_dir_offsets, 1)))
+    return MZ_FALSE;
+
+  pStream->m_pZip = pZip;
+  pStream->m_pArchive_name = pArchive_name;
+  pStream->m_crc32 = MZ_CRC32_INIT;
+  pStream->m_local_dir_header_ofs = pZip->m_archive_size + num_alignment_padding_bytes;
+  pStream->m_cur_archive_file_ofs = pStream->m_local_dir_header_ofs + MZ_ZIP_LOCAL_DIR_HEADER_SIZE;
+
+  if (level)
+  {
+    if (NULL == (pStream->m_pComp = pZip->m_pAlloc(pZip->m_pAlloc_opaque, 1, sizeof(tdefl_compressor))))
+    {
+      pStream->m_pZip = NULL;
+      return MZ_FALSE;
+    }
+    if (tdefl_init((tdefl_compressor *)pStream->m_pComp, mz_zip_writer_stream_put_buf_callback, pStream, tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY)) != TDEFL_STATUS_OKAY)
+    {
+      mz_zip_writer_add_stream_abort(pStream);
+      return MZ_FALSE;
+    }
+    pStream->m_method = MZ_DEFLATED;
+  }
+
+  // The local header is written for real once the sizes and CRC are known.
+  if ((!mz_zip_writer_write_zeros(pZip, pZip->m_archive_size, num_alignment_padding_bytes + MZ_ZIP_LOCAL_DIR_HEADER_SIZE)) ||
+      (pZip->m_pWrite(pZip->m_pIO_opaque, pStream->m_cur_archive_file_ofs, pArchive_name, archive_name_size) != archive_name_size))
+  {
+    mz_zip_writer_add_stream_abort(pStream);
+    return MZ_FALSE;
+  }
+  pStream->m_cur_archive_file_ofs += archive_name_size;
+
+  return MZ_TRUE;
+}
+
+mz_bool mz_zip_writer_add_stream_write(mz_zip_writer_stream *pStream, const void *pBuf, size_t buf_size)
+{
+  mz_zip_archive *pZip = pStream->m_pZip;
+
+  if ((!pZip) || ((buf_size) && (!pBuf)))
+    return MZ_FALSE;
+
+  pStream->m_crc32 = (mz_uint32)mz_crc32(pStream->m_crc32, (const mz_uint8 *)pBuf, buf_size);
+  pStream->m_uncomp_size += buf_size;
+  // no zip64 support yet
+  if (pStream->m_uncomp_size > 0xFFFFFFFF)
+    return MZ_FALSE;
+
+  if (pStream->m_pComp)
+    return tdefl_compress_buffer((tdefl_compressor *)pStream->m_pComp, pBuf, buf_size, TDEFL_NO_FLUSH) == TDEFL_STATUS_OKAY;
+
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, pStream->m_cur_archive_file_ofs, pBuf, buf_size) != buf_size)
+    return MZ_FALSE;
+  pStream->m_cur_archive_file_ofs += buf_size;
+  pStream->m_comp_size += buf_size;
+
+  return MZ_TRUE;
+}
+
+mz_bool mz_zip_writer_add_stream_end(mz_zip_writer_stream *pStream)
+{
+  mz_zip_archive *pZip = pStream->m_pZip;
+  mz_uint8 local_dir_header[MZ_ZIP_LOCAL_DIR_HEADER_SIZE];
+  size_t archive_name_size;
+
+  if (!pZip)
+    return MZ_FALSE;
+
+  if ((pStream->m_pComp) && (tdefl_compress_buffer((tdefl_compressor *)pStream->m_pComp, NULL, 0, TDEFL_FINISH) != TDEFL_STATUS_DONE))
+  {
+    mz_zip_writer_add_stream_abort(pStream);
+    return MZ_FALSE;
+  }
+  pZip->m_pFree(pZip->m_pAlloc_opaque, pStream->m_pComp);
+  pStream->m_pComp = NULL;
+  pStream->m_pZip = NULL;
+
+  // no zip64 support yet
+  if ((pStream->m_comp_size > 0xFFFFFFFF) || (pStream->m_cur_archive_file_ofs > 0xFFFFFFFF))
+    return MZ_FALSE;
+
+  archive_name_size = strlen(pStream->m_pArchive_name);
+  if (!mz_zip_writer_create_local_dir_header(pZip, local_dir_header, (mz_uint16)archive_name_size, 0, pStream->m_uncomp_size, pStream->m_comp_size, pStream->m_crc32, pStream->m_method, 0, pStream->m_dos_time, pStream->m_dos_date))
+    return MZ_FALSE;
+
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, pStream->m_local_dir_header_ofs, local_dir_header, sizeof(local_dir_header)) != sizeof(local_dir_header))
+    return MZ_FALSE;
+
+  if (!mz_zip_writer_add_to_central_dir(pZip, pStream->m_pArchive_name, (mz_uint16)archive_name_size, NULL, 0, NULL, 0, pStream->m_uncomp_size, pStream->m_comp_size, pStream->m_crc32, pStream->m_method, 0, pStream->m_dos_time, pStream->m_dos_date, pStream->m_local_dir_header_ofs, 0))
+    return MZ_FALSE;
+
+  pZip->m_total_files++;
+  pZip->m_archive_size = pStream->m_cur_archive_file_ofs;
+
+  return MZ_TRUE;
+}
+
+// The archive size isn't advanced until the entry is ended, so whatever was written for an aborted entry is overwritten by the next one.
+void mz_zip_writer_add_stream_abort(mz_zip_writer_stream *pStream)
+{
+  if (!pStream->m_pZip)
+    return;
+  pStream->m_pZip->m_pFree(pStream->m_pZip->m_pAlloc_opaque, pStream->m_pComp);
+  pStream->m_pComp = NULL;
+  pStream->m_pZip = NULL;
+}
+
 #ifndef MINIZ_NO_STDIO
 mz_bool mz_zip_writer_add_file(mz_zip_archive *pZip, const char *pArchive_name, const char *pSrc_filename, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags)
 {
@@ -4560,6 +5077,110 @@ mz_bool mz_zip_writer_add_from_zip_reader(mz_zip_archive *pZip, mz_zip_archive *
   return MZ_TRUE;
 }
 
+mz_bool mz_zip_writer_add_from_zip_reader_as(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index, const char *pArchive_name)
+{
+  mz_uint n, num_alignment_padding_bytes;
+  mz_uint16 method, bit_flags, dos_time, dos_date;
+  mz_uint32 uncomp_crc32, ext_attributes;
+  mz_uint64 comp_size, uncomp_size, comp_bytes_remaining, local_dir_header_ofs;
+  mz_uint64 cur_src_file_ofs, cur_dst_file_ofs;
+  mz_uint32 local_header_u32[(MZ_ZIP_LOCAL_DIR_HEADER_SIZE + sizeof(mz_uint32) - 1) / sizeof(mz_uint32)]; mz_uint8 *pLocal_header = (mz_uint8 *)local_header_u32;
+  size_t archive_name_size;
+  void *pBuf; const mz_uint8 *pSrc_central_header;
+
+  if ((!pZip) || (!pZip->m_pState) || (pZip->m_zip_mode != MZ_ZIP_MODE_WRITING) || (!pArchive_name))
+    return MZ_FALSE;
+  if (NULL == (pSrc_central_header = mz_zip_reader_get_cdh(pSource_zip, file_index)))
+    return MZ_FALSE;
+  if (!mz_zip_writer_validate_archive_name(pArchive_name))
+    return MZ_FALSE;
+  archive_name_size = strlen(pArchive_name);
+  if (archive_name_size > 0xFFFF)
+    return MZ_FALSE;
+
+  method = MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_METHOD_OFS);
+  // Encrypted and patched entries can't be moved under a new header. Any data descriptor is dropped since the new local header carries the sizes.
+  bit_flags = MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_BIT_FLAG_OFS);
+  if ((bit_flags & (1 | 32 | 64)) || ((method != 0) && (method != MZ_DEFLATED)))
+    return MZ_FALSE;
+  bit_flags &= ~8;
+  dos_time = MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_FILE_TIME_OFS);
+  dos_date = MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_FILE_DATE_OFS);
+  uncomp_crc32 = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_CRC32_OFS);
+  comp_size = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_COMPRESSED_SIZE_OFS);
+  uncomp_size = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_DECOMPRESSED_SIZE_OFS);
+  ext_attributes = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_EXTERNAL_ATTR_OFS);
+
+  num_alignment_padding_bytes = mz_zip_writer_compute_padding_needed_for_file_alignment(pZip);
+
+  // no zip64 support yet
+  if ((pZip->m_total_files == 0xFFFF) || ((pZip->m_archive_size + num_alignment_padding_bytes + MZ_ZIP_LOCAL_DIR_HEADER_SIZE + MZ_ZIP_CENTRAL_DIR_HEADER_SIZE + archive_name_size * 2 + comp_size) > 0xFFFFFFFF))
+    return MZ_FALSE;
+
+  cur_src_file_ofs = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_LOCAL_HEADER_OFS);
+  cur_dst_file_ofs = pZip->m_archive_size;
+
+  if (pSource_zip->m_pRead(pSource_zip->m_pIO_opaque, cur_src_file_ofs, pLocal_header, MZ_ZIP_LOCAL_DIR_HEADER_SIZE) != MZ_ZIP_LOCAL_DIR_HEADER_SIZE)
+    return MZ_FALSE;
+  if (MZ_READ_LE32(pLocal_header) != MZ_ZIP_LOCAL_DIR_HEADER_SIG)
+    return MZ_FALSE;
+  cur_src_file_ofs += MZ_ZIP_LOCAL_DIR_HEADER_SIZE + MZ_READ_LE16(pLocal_header + MZ_ZIP_LDH_FILENAME_LEN_OFS) + MZ_READ_LE16(pLocal_header + MZ_ZIP_LDH_EXTRA_LEN_OFS);
+  if ((cur_src_file_ofs + comp_size) > pSource_zip->m_archive_size)
+    return MZ_FALSE;
+
+  if (!mz_zip_writer_write_zeros(pZip, cur_dst_file_ofs, num_alignment_padding_bytes))
+    return MZ_FALSE;
+  cur_dst_file_ofs += num_alignment_padding_bytes;
+  local_dir_header_ofs = cur_dst_file_ofs;
+  if (pZip->m_file_offset_alignment) { MZ_ASSERT((local_dir_header_ofs & (pZip->m_file_offset_alignment - 1)) == 0); }
+
+  if (!mz_zip_writer_create_local_dir_header(pZip, pLocal_header, (mz_uint16)archive_name_size, 0, uncomp_size, comp_size, uncomp_crc32, method, bit_flags, dos_time, dos_date))
+    return MZ_FALSE;
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pLocal_header, MZ_ZIP_LOCAL_DIR_HEADER_SIZE) != MZ_ZIP_LOCAL_DIR_HEADER_SIZE)
+    return MZ_FALSE;
+  cur_dst_file_ofs += MZ_ZIP_LOCAL_DIR_HEADER_SIZE;
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pArchive_name, archive_name_size) != archive_name_size)
+    return MZ_FALSE;
+  cur_dst_file_ofs += archive_name_size;
+
+  comp_bytes_remaining = comp_size;
+  if (NULL == (pBuf = pZip->m_pAlloc(pZip->m_pAlloc_opaque, 1, (size_t)MZ_MAX(1, MZ_MIN(MZ_ZIP_MAX_IO_BUF_SIZE, comp_bytes_remaining)))))
+    return MZ_FALSE;
+
+  while (comp_bytes_remaining)
+  {
+    n = (mz_uint)MZ_MIN(MZ_ZIP_MAX_IO_BUF_SIZE, comp_bytes_remaining);
+    if (pSource_zip->m_pRead(pSource_zip->m_pIO_opaque, cur_src_file_ofs, pBuf, n) != n)
+    {
+      pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+      return MZ_FALSE;
+    }
+    cur_src_file_ofs += n;
+
+    if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pBuf, n) != n)
+    {
+      pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+      return MZ_FALSE;
+    }
+    cur_dst_file_ofs += n;
+
+    comp_bytes_remaining -= n;
+  }
+  pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+
+  // no zip64 support yet
+  if (cur_dst_file_ofs > 0xFFFFFFFF)
+    return MZ_FALSE;
+
+  if (!mz_zip_writer_add_to_central_dir(pZip, pArchive_name, (mz_uint16)archive_name_size, NULL, 0, NULL, 0, uncomp_size, comp_size, uncomp_crc32, method, bit_flags, dos_time, dos_date, local_dir_header_ofs, ext_attributes))
+    return MZ_FALSE;
+
+  pZip->m_total_files++;
+  pZip->m_archive_size = cur_dst_file_ofs;
+
+  return MZ_TRUE;
+}
+
 mz_bool mz_zip_writer_finalize_archive(mz_zip_archive *pZip)
 {
   mz_zip_internal_state *pState;
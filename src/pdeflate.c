@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#include "fileset.h"
+
+/*
+ * Block-parallel deflate, pigz style.  The input is cut into fixed blocks
+ * that are compressed independently on worker threads.  Every block but the
+ * first is primed with the 32k of input in front of it, and every block but
+ * the last ends with a sync flush, so the pieces concatenate into a single
+ * raw deflate stream.  Each block also gets its own CRC-32, which are
+ * combined at the end.
+ */
+#define PDEFLATE_BLOCK_SIZE	(128 * 1024)
+#define PDEFLATE_DICT_SIZE	(32 * 1024)
+#define PDEFLATE_MAX_THREADS	64
+
+struct pdeflate_block {
+	unsigned char	*buf;
+	size_t		size;
+	size_t		capacity;
+	mz_ulong	crc;
+	int		failed;
+};
+
+struct pdeflate_job {
+	const unsigned char	*in;
+	size_t			len;
+	int			flags;
+	size_t			nblocks;
+	size_t			next;
+	pthread_mutex_t		lock;
+	struct pdeflate_block	*blocks;
+};
+
+static mz_bool
+pdeflate_put(const void *buf, int len, void *user)
+{
+	struct pdeflate_block *blk = (struct pdeflate_block *)user;
+
+	if (blk->size + len > blk->capacity) {
+		size_t capacity = blk->capacity ? blk->capacity : 4096;
+		unsigned char *nbuf;
+		while (capacity < blk->size + len) {
+			capacity *= 2;
+		}
+		if ((nbuf = (unsigned char *)realloc(blk->buf, capacity)) == NULL) {
+			return MZ_FALSE;
+		}
+		blk->buf = nbuf;
+		blk->capacity = capacity;
+	}
+	memcpy(blk->buf + blk->size, buf, len);
+	blk->size += len;
+
+	return MZ_TRUE;
+}
+
+static void *
+pdeflate_worker(void *arg)
+{
+	struct pdeflate_job	*job = (struct pdeflate_job *)arg;
+	tdefl_compressor	*comp;
+
+	if ((comp = (tdefl_compressor *)malloc(sizeof(tdefl_compressor))) == NULL) {
+		return NULL;
+	}
+	for (;;) {
+		struct pdeflate_block	*blk;
+		size_t			i, start, size;
+		int			last;
+		tdefl_status		status;
+
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->nblocks) {
+			break;
+		}
+
+		blk = &job->blocks[i];
+		start = i * PDEFLATE_BLOCK_SIZE;
+		size = job->len - start < PDEFLATE_BLOCK_SIZE ? job->len - start : PDEFLATE_BLOCK_SIZE;
+		last = (i == job->nblocks - 1);
+
+		blk->crc = mz_crc32(MZ_CRC32_INIT, job->in + start, size);
+		tdefl_init(comp, pdeflate_put, blk, job->flags);
+		if (start) {
+			size_t dict = start < PDEFLATE_DICT_SIZE ? start : PDEFLATE_DICT_SIZE;
+			tdefl_set_dictionary(comp, job->in + start - dict, dict);
+		}
+		status = tdefl_compress_buffer(comp, job->in + start, size, last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+		blk->failed = (status != (last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY));
+	}
+	free(comp);
+
+	return NULL;
+}
+
+/*
+ * CRC-32 of two concatenated pieces from the CRC of each, by applying
+ * len2 zero bytes to crc1 as a GF(2) matrix power (as in zlib).
+ */
+static mz_ulong
+gf2_matrix_times(mz_ulong *mat, mz_ulong vec)
+{
+	mz_ulong sum = 0;
+
+	while (vec) {
+		if (vec & 1) {
+			sum ^= *mat;
+		}
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void
+gf2_matrix_square(mz_ulong *square, mz_ulong *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++) {
+		square[n] = gf2_matrix_times(mat, mat[n]);
+	}
+}
+
+static mz_ulong
+crc32_combine(mz_ulong crc1, mz_ulong crc2, size_t len2)
+{
+	mz_ulong	even[32], odd[32], row;
+	int		n;
+
+	if (len2 == 0) {
+		return crc1;
+	}
+
+	odd[0] = 0xedb88320UL;
+	row = 1;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+	gf2_matrix_square(even, odd);
+	gf2_matrix_square(odd, even);
+
+	do {
+		gf2_matrix_square(even, odd);
+		if (len2 & 1) {
+			crc1 = gf2_matrix_times(even, crc1);
+		}
+		len2 >>= 1;
+		if (len2 == 0) {
+			break;
+		}
+		gf2_matrix_square(odd, even);
+		if (len2 & 1) {
+			crc1 = gf2_matrix_times(odd, crc1);
+		}
+		len2 >>= 1;
+	} while (len2);
+
+	return crc1 ^ crc2;
+}
+
+void *
+pdeflate(const void *in, size_t len, int level, size_t *out_len, mz_uint32 *crc)
+{
+	struct pdeflate_job	job;
+	pthread_t		threads[PDEFLATE_MAX_THREADS];
+	unsigned char		*out = NULL;
+	long			nthreads;
+	size_t			i, total = 0;
+	int			failed = 0;
+
+	job.in = (const unsigned char *)in;
+	job.len = len;
+	job.flags = tdefl_create_comp_flags_from_zip_params(level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+	job.nblocks = len ? (len + PDEFLATE_BLOCK_SIZE - 1) / PDEFLATE_BLOCK_SIZE : 1;
+	job.next = 0;
+	if ((job.blocks = (struct pdeflate_block *)calloc(job.nblocks, sizeof(struct pdeflate_block))) == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < job.nblocks; i++) {
+		job.blocks[i].failed = 1;
+	}
+	pthread_mutex_init(&job.lock, NULL);
+
+	// The calling thread works too, so only start helpers for extra blocks
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (nthreads > (long)job.nblocks - 1) {
+		nthreads = job.nblocks - 1;
+	}
+	if (nthreads > PDEFLATE_MAX_THREADS) {
+		nthreads = PDEFLATE_MAX_THREADS;
+	}
+	for (i = 0; (long)i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, pdeflate_worker, &job)) {
+			break;
+		}
+	}
+	nthreads = i;
+	pdeflate_worker(&job);
+	for (i = 0; (long)i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+
+	*crc = MZ_CRC32_INIT;
+	for (i = 0; i < job.nblocks; i++) {
+		size_t start = i * PDEFLATE_BLOCK_SIZE;
+		size_t size = len - start < PDEFLATE_BLOCK_SIZE ? len - start : PDEFLATE_BLOCK_SIZE;
+		failed |= job.blocks[i].failed;
+		total += job.blocks[i].size;
+		*crc = (mz_uint32)crc32_combine(*crc, job.blocks[i].crc, size);
+	}
+	if (!failed && (out = (unsigned char *)malloc(total ? total : 1)) != NULL) {
+		total = 0;
+		for (i = 0; i < job.nblocks; i++) {
+			memcpy(out + total, job.blocks[i].buf, job.blocks[i].size);
+			total += job.blocks[i].size;
+		}
+		*out_len = total;
+	}
+	for (i = 0; i < job.nblocks; i++) {
+		free(job.blocks[i].buf);
+	}
+	free(job.blocks);
+
+	return out;
+}
+
+/*
+ * Add a buffer to a zip at the given deflate level, compressing it with
+ * pdeflate() and storing it instead if that doesn't make it any smaller.
+ */
+int
+zip_add_mem(mz_zip_archive *zip, char *name, const void *buf, size_t len, int level)
+{
+	void		*comp;
+	size_t		comp_len;
+	mz_uint32	crc;
+	int		status;
+
+	if (level == 0 || len == 0) {
+		return mz_zip_writer_add_mem(zip, name, buf, len, MZ_NO_COMPRESSION);
+	}
+	if ((comp = pdeflate(buf, len, level, &comp_len, &crc)) == NULL) {
+		return 0;
+	}
+	if (comp_len >= len) {
+		status = mz_zip_writer_add_mem(zip, name, buf, len, MZ_NO_COMPRESSION);
+	} else {
+		status = mz_zip_writer_add_mem_ex(zip, name, comp, comp_len, NULL, 0, level | MZ_ZIP_FLAG_COMPRESSED_DATA, len, crc);
+	}
+	free(comp);
+
+	return status;
+}
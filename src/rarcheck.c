@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#include "fileset.h"
+
+/*
+ * Members of a non-solid rar don't depend on each other, so they can be
+ * unpacked on worker threads, each with its own handle seeked to the
+ * member's header as found by an earlier pass over the headers.  Workers
+ * pick members off a shared counter as in zipcheck.c, but the results go
+ * back to the caller in archive order and on its own thread, so they can
+ * be committed just as a single pass would.  Workers run at most
+ * RARCHECK_AHEAD members per thread ahead of the oldest one not handed
+ * back yet, which bounds the memory held by kept members.
+ */
+#define RARCHECK_MAX_THREADS	64
+#define RARCHECK_AHEAD		2
+
+struct rarcheck_job {
+	char		*path;
+	struct rarpart	*parts;
+	int		nparts;
+	int		next;
+	int		limit;	// first member not to start yet
+	int		keep;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+};
+
+static void
+rarcheck_part(HANDLE rararc, struct rarpart *part, int keep)
+{
+	struct RARHeaderDataSlim hdr;
+
+	if ((part->status = RARSeekHeader(rararc, part->pos)) != 0 ||
+	    (part->status = RARReadHeaderSlim(rararc, &hdr)) != 0) {
+		return;
+	}
+	part->name = strdup(hdr.FileName);
+	part->size = hdr.UnpSize;
+	if (hdr.HeaderPos != part->pos || hdr.FileCRC != part->crc) {
+		part->status = ERAR_BAD_DATA;
+	} else if (keep) {
+		if ((part->data = rar_extract_to_mem(rararc, &hdr)) == NULL) {
+			part->status = ERAR_BAD_DATA;
+		}
+	} else {
+		part->status = RARProcessFile(rararc, RAR_TEST, NULL, NULL);
+	}
+}
+
+static void *
+rarcheck_worker(void *arg)
+{
+	struct rarcheck_job	*job = (struct rarcheck_job *)arg;
+	HANDLE			rararc;
+
+	rararc = rar_open_pool(NULL, job->path, 1);
+	for (;;) {
+		int i;
+
+		pthread_mutex_lock(&job->lock);
+		while (job->next < job->nparts && job->next >= job->limit) {
+			pthread_cond_wait(&job->cond, &job->lock);
+		}
+		i = job->next < job->nparts ? job->next++ : job->nparts;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->nparts) {
+			break;
+		}
+
+		if (rararc == NULL) {
+			job->parts[i].status = ERAR_EOPEN;
+		} else {
+			rarcheck_part(rararc, &job->parts[i], job->keep);
+		}
+
+		pthread_mutex_lock(&job->lock);
+		job->parts[i].done = 1;
+		pthread_cond_broadcast(&job->cond);
+		pthread_mutex_unlock(&job->lock);
+	}
+	if (rararc != NULL) {
+		rar_close(rararc);
+	}
+
+	return NULL;
+}
+
+/*
+ * Unpack the parts of the rar at path (or path.rar) on worker threads,
+ * keeping the data if keep is set and only testing it otherwise, and hand
+ * each part to done() in order.  Every part must have a HeaderPos.
+ * Returns the number of parts that failed, or -1 if it isn't worth
+ * starting threads or they couldn't be started, in which case nothing was
+ * unpacked.
+ */
+int
+rar_parallel(char *path, struct rarpart *parts, int nparts, int keep, void (*done)(struct rarpart *, void *), void *user)
+{
+	struct rarcheck_job	job;
+	pthread_t		threads[RARCHECK_MAX_THREADS];
+	long			nthreads;
+	int			bad = 0;
+	int			i;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > nparts) {
+		nthreads = nparts;
+	}
+	if (nthreads > RARCHECK_MAX_THREADS) {
+		nthreads = RARCHECK_MAX_THREADS;
+	}
+	if (nthreads < 2) {
+		return -1;
+	}
+
+	job.path = path;
+	job.parts = parts;
+	job.nparts = nparts;
+	job.next = 0;
+	job.limit = nthreads * RARCHECK_AHEAD;
+	job.keep = keep;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.cond, NULL);
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, rarcheck_worker, &job)) {
+			break;
+		}
+	}
+	if ((nthreads = i) == 0) {
+		pthread_cond_destroy(&job.cond);
+		pthread_mutex_destroy(&job.lock);
+		return -1;
+	}
+
+	for (i = 0; i < nparts; i++) {
+		pthread_mutex_lock(&job.lock);
+		while (!parts[i].done) {
+			pthread_cond_wait(&job.cond, &job.lock);
+		}
+		pthread_mutex_unlock(&job.lock);
+
+		done(&parts[i], user);
+		if (parts[i].status != 0) {
+			bad++;
+		}
+		free(parts[i].data);
+		free(parts[i].name);
+		parts[i].data = NULL;
+		parts[i].name = NULL;
+
+		pthread_mutex_lock(&job.lock);
+		job.limit = i + 1 + nthreads * RARCHECK_AHEAD;
+		pthread_cond_broadcast(&job.cond);
+		pthread_mutex_unlock(&job.lock);
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.lock);
+
+	return bad;
+}
+
+struct rarcheck_verify {
+	char	*path;
+	int	mode;
+};
+
+static void
+rarcheck_report(struct rarpart *part, void *user)
+{
+	struct rarcheck_verify *v = (struct rarcheck_verify *)user;
+
+	if (part->status != 0) {
+		fprintf(stdout, "RFile: %s/%s\tCorrupt\n", v->path, part->name != NULL ? part->name : "?");
+	} else if (v->mode & VERBOSE) {
+		fprintf(stdout, "RFile: %s/%s\tIntact\n", v->path, part->name);
+	}
+}
+
+/*
+ * Test every member in one pass over the archive, for solid archives and
+ * volume sets, or when there's only one thread to do it on.
+ */
+static int
+rarcheck_serial(char *path, int mode)
+{
+	struct rarcheck_verify	v = {path, mode};
+	HANDLE			rararc;
+	int			bad = 0;
+
+	if ((rararc = rar_open(path, 1)) == NULL) {
+		return -1;
+	}
+	for (;;) {
+		struct RARHeaderDataSlim hdr;
+		struct rarpart part;
+
+		if (RARReadHeaderSlim(rararc, &hdr) != 0) {
+			break;
+		}
+		if ((hdr.Flags & 0xe0) == 0xe0) {
+			continue;
+		}
+		// The tail of a file continued from an earlier volume is
+		// tested along with its head
+		if (hdr.Flags & 0x01) {
+			RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+			continue;
+		}
+		// The name goes when the next header is read in testing
+		memset(&part, 0, sizeof(struct rarpart));
+		part.name = strdup(hdr.FileName);
+		part.status = RARProcessFile(rararc, RAR_TEST, NULL, NULL);
+		rarcheck_report(&part, &v);
+		if (part.status != 0) {
+			bad++;
+		}
+		free(part.name);
+	}
+	rar_close(rararc);
+
+	return bad;
+}
+
+/*
+ * Unpack every member of the rar at path (or path.rar) and check it
+ * against its CRC.  Returns the number of bad members, or -1 if the rar
+ * couldn't be read.
+ */
+int
+rar_deep_verify(char *path, int mode)
+{
+	struct rarcheck_verify	v = {path, mode};
+	struct rarpart		*parts = NULL;
+	HANDLE			rararc;
+	int			nparts = 0, bad = -1;
+	int			independent = 1, format50 = 0;
+
+	if ((rararc = rar_open(path, 0)) == NULL) {
+		return -1;
+	}
+	for (;;) {
+		struct RARHeaderDataSlim hdr;
+
+		if (RARReadHeaderSlim(rararc, &hdr) != 0) {
+			break;
+		}
+		if ((hdr.Flags & 0xe0) == 0xe0) {
+			continue;
+		}
+		if (hdr.UnpVer >= 50) {
+			format50 = 1;
+		}
+		if (hdr.HeaderPos == ~0ULL) {
+			independent = 0;
+		}
+		parts = (struct rarpart *)realloc(parts, (nparts + 1) * sizeof(struct rarpart));
+		memset(&parts[nparts], 0, sizeof(struct rarpart));
+		parts[nparts].pos = hdr.HeaderPos;
+		parts[nparts].crc = hdr.FileCRC;
+		nparts++;
+		RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+	}
+	rar_close(rararc);
+
+	// RAR 5.0 archives are only listed
+	if (format50) {
+		fprintf(stderr, "error: can't unpack RAR 5.0 archive %s for deep verify\n", path);
+		free(parts);
+		return 0;
+	}
+	if (independent) {
+		bad = rar_parallel(path, parts, nparts, 0, rarcheck_report, &v);
+	}
+	if (bad == -1) {
+		bad = rarcheck_serial(path, mode);
+	}
+	free(parts);
+
+	return bad;
+}
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -25,13 +27,21 @@ move_file(char *src, char *dest_dir, char *dest_file, void *fi, int mode)
 	}
 
 	if (mode & ZIP) {
+		mz_zip_archive *ziparc;
 		dest = sqlite3_mprintf("%s.zip", dest_dir);
 
 		make_dirtree(dest_dir, 0);
-		if (!mz_zip_add_mem_to_archive_file_in_place(dest, dest_file, in->buffer, in->bufsiz, NULL, 0, MZ_NO_COMPRESSION)) {
-			fprintf(stderr, "error: mz_zip_add_mem_to_archive_file_in_place failed, %d\n");
+		if ((ziparc = zip_writer_get(dest)) == NULL ||
+		    !zip_add_mem(ziparc, dest_file, in->buffer, in->bufsiz, GET_LEVEL(mode))) {
+			fprintf(stderr, "error: couldn't add %s to %s\n", dest_file, dest);
+			sqlite3_free(dest);
 			return -1;
 		}
+		if (mode & DELETE) {
+			// Source goes away only once the zip has been finalized
+			zip_writer_defer_unlink(ziparc, src);
+			mode &= ~DELETE;
+		}
 	} else {
 		dest =  sqlite3_mprintf("%s/%s", dest_dir, dest_file);
 		make_dirtree(dest, 0);
@@ -67,16 +77,29 @@ move_zip(char *src, char *dest_dir, char *dest_file, void *zi, int mode)
 
 	if (mode & ONLY_DELETE) {
 	} else if (mode & ZIP) {
+		mz_zip_archive *ziparc;
 		dest = sqlite3_mprintf("%s.zip", dest_dir);
-		char *buffer = (char *)malloc(zip->stat->m_uncomp_size);
 
 		make_dirtree(dest_dir, 0);
-		mz_zip_reader_extract_to_mem(zip->zip, zip->index, buffer, zip->stat->m_uncomp_size, 0);
-		if (!mz_zip_add_mem_to_archive_file_in_place(dest, dest_file, buffer, zip->stat->m_uncomp_size, NULL, 0, MZ_NO_COMPRESSION)) {
-			fprintf(stderr, "error: mz_zip_add_mem_to_archive_file_in_place failed, %d\n");
+		if ((ziparc = zip_writer_get(dest)) == NULL) {
+			fprintf(stderr, "error: couldn't open %s\n", dest);
+			sqlite3_free(dest);
 			return -1;
 		}
-		free(buffer);
+		// Copy the compressed stream as is, fall back to inflating
+		// members the raw copy can't carry (encrypted, data descriptors)
+		if (!mz_zip_writer_add_from_zip_reader_as(ziparc, zip->zip, zip->index, dest_file)) {
+			char *buffer = (char *)malloc(zip->stat->m_uncomp_size);
+
+			if (!mz_zip_reader_extract_to_mem(zip->zip, zip->index, buffer, zip->stat->m_uncomp_size, 0) ||
+			    !zip_add_mem(ziparc, dest_file, buffer, zip->stat->m_uncomp_size, GET_LEVEL(mode))) {
+				fprintf(stderr, "error: couldn't add %s to %s\n", dest_file, dest);
+				free(buffer);
+				sqlite3_free(dest);
+				return -1;
+			}
+			free(buffer);
+		}
 	} else {
 		dest = sqlite3_mprintf("%s/%s", dest_dir, dest_file);
 		make_dirtree(dest, 0);
@@ -96,18 +119,19 @@ move_rar(char *src, char *dest_dir, char *dest_file, void *ri, int mode)
 
 	if (mode & ONLY_DELETE) {
 	} else if (mode & ZIP) {
+		mz_zip_archive *ziparc;
 		dest = sqlite3_mprintf("%s.zip", dest_dir);
-		char *buffer = (char *)malloc(rar->hdr->UnpSize);
-		char *bptr = buffer;
 
 		make_dirtree(dest_dir, 0);
-		RARSetCallback(rar->rar, rar_extract_to_mem, (long)&bptr);
-		RARProcessFile(rar->rar, RAR_EXTRACT, NULL, NULL);
-		if (!mz_zip_add_mem_to_archive_file_in_place(dest, dest_file, buffer, rar->hdr->UnpSize, NULL, 0, MZ_NO_COMPRESSION)) {
-			fprintf(stderr, "error: mz_zip_add_mem_to_archive_file_in_place failed, %d\n");
+		if ((ziparc = zip_writer_get(dest)) == NULL) {
+			RARProcessFile(rar->rar, RAR_SKIP, NULL, NULL);
+		}
+		if (ziparc == NULL ||
+		    !rar_extract_to_zip(rar->rar, rar->hdr, ziparc, dest_file, GET_LEVEL(mode))) {
+			fprintf(stderr, "error: couldn't add %s to %s\n", dest_file, dest);
+			sqlite3_free(dest);
 			return -1;
 		}
-		free(buffer);
 	} else {
 		dest = sqlite3_mprintf("%s/%s", dest_dir, dest_file);
 		make_dirtree(dest, 0);
@@ -217,22 +241,152 @@ verify_zip(sqlite3 *db, char *path, mz_zip_archive *ziparc, int mode)
 			fprintf(stdout, "ZFile: %s/%s\t%s\n", path, buf, id>0?"Found":"Unknown");
 		}
 	}
+	if (mode & DEEP && zip_deep_verify(path, mode) == -1) {
+		fprintf(stderr, "error: couldn't read %s for deep verify\n", path);
+	}
 
 	return count;
 }
 
+/*
+ * Hunting a rar is planned from the headers alone: verify_rar() walks them
+ * on a list handle and notes which members are hits, then hunt_rar() makes
+ * one pass over the archive opened for extraction, routing the hits and
+ * skipping the rest.  Skipping a member of a solid archive means decoding
+ * and discarding it, since the members after it depend on it, so the pass
+ * stops after the last hit and the archive is decoded at most once.
+ */
+struct rarhit {
+	int			index;	// among the members verify_rar() counts
+	int			id;
+	unsigned int		crc;
+	unsigned long long	size;
+	unsigned long long	pos;	// HeaderPos, ~0 if it depends on others
+};
+
+/*
+ * Hunting into zips takes the members from memory anyway, so when every
+ * hit can be unpacked on its own and is small enough, rar_parallel() does
+ * the unpacking and the hits are added in archive order as they come back.
+ */
+struct rarhunt {
+	sqlite3	*db;
+	char	*path;
+	int	mode;
+};
+
+static void
+hunt_rar_part(struct rarpart *part, void *user)
+{
+	struct rarhunt	*h = (struct rarhunt *)user;
+	struct fileinfo	fi = {(char *)part->data, part->size, 0};
+	char		*dest;
+
+	if (part->status != 0) {
+		return;
+	}
+	dest = archive_file(h->db, h->path, part->id, &move_file, &fi, h->mode & ~DELETE);
+	fprintf(stderr, "Move %s to %s\n", h->path, dest);
+	sqlite3_free(dest);
+}
+
+static int
+hunt_rar_parallel(sqlite3 *db, char *path, struct rarhit *hits, int nhits, int mode)
+{
+	struct rarhunt	h = {db, path, mode};
+	struct rarpart	*parts;
+	int		bad, i;
+
+	if (!(mode & ZIP) || mode & ONLY_DELETE) {
+		return -1;
+	}
+	for (i = 0; i < nhits; i++) {
+		if (hits[i].pos == ~0ULL || hits[i].size > RAR_WHOLE_MAX) {
+			return -1;
+		}
+	}
+	parts = (struct rarpart *)calloc(nhits, sizeof(struct rarpart));
+	for (i = 0; i < nhits; i++) {
+		parts[i].pos = hits[i].pos;
+		parts[i].crc = hits[i].crc;
+		parts[i].id = hits[i].id;
+	}
+	if ((bad = rar_parallel(path, parts, nhits, 1, hunt_rar_part, &h)) > 0) {
+		fprintf(stderr, "error: couldn't extract %d files from %s\n", bad, path);
+	}
+	free(parts);
+
+	return bad;
+}
+
+static void
+hunt_rar(sqlite3 *db, char *path, struct rarhit *hits, int nhits, int mode)
+{
+	HANDLE	rararc;
+	int	index = 0, h = 0;
+
+	if (hunt_rar_parallel(db, path, hits, nhits, mode) != -1) {
+		return;
+	}
+	if ((rararc = rar_open(path, 1)) == NULL) {
+		fprintf(stderr, "error: couldn't open %s for extraction\n", path);
+		return;
+	}
+	while (h < nhits) {
+		struct RARHeaderDataSlim hdr;
+		if (RARReadHeaderSlim(rararc, &hdr) != 0) {
+			break;
+		}
+		if ((hdr.Flags & 0xe0) == 0xe0) {
+			continue;
+		}
+		// The list handle never shows the tail of a file continued from
+		// an earlier volume, so don't count it here either
+		if (hdr.Flags & 0x01) {
+			RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+			continue;
+		}
+		if (index++ == hits[h].index && hdr.FileCRC == hits[h].crc) {
+			struct rarinfo ri = {rararc, &hdr};
+			char *dest = archive_file(db, path, hits[h].id, &move_rar, &ri, mode);
+			fprintf(stderr, "Move %s to %s\n", path, dest);
+			sqlite3_free(dest);
+			h++;
+		} else if (RARProcessFile(rararc, RAR_SKIP, NULL, NULL) != 0) {
+			break;
+		}
+	}
+	if (h < nhits) {
+		fprintf(stderr, "error: couldn't extract %d files from %s\n", nhits - h, path);
+	}
+	rar_close(rararc);
+}
+
+/*
+ * restored is set when the set was just rebuilt from its recovery volumes,
+ * so it isn't rebuilt again.  With VERBOSE the member lines are held until
+ * the listing is through, so a set that's rebuilt and listed again only
+ * has them printed once.
+ */
 int
-verify_rar(sqlite3 *db, char *path, HANDLE *rararc, int mode)
+verify_rar(sqlite3 *db, char *path, HANDLE *rararc, int mode, int restored)
 {
-	int i;
-	int id;
+	struct rarhit	*hits = NULL;
+	int		nhits = 0;
+	int		id;
+	int		count = 0;
+	int		retval, broken = 0;
+	char		*report = NULL;
+	size_t		reportlen = 0;
+	FILE		*out = stdout;
 
-	int count = 0;
+	if (mode & VERBOSE && (out = open_memstream(&report, &reportlen)) == NULL) {
+		out = stdout;
+	}
 
 	for (;;) {
-		struct RARHeaderDataEx hdr = {0};
-		int retval;
-		if ((retval = RARReadHeaderEx(rararc, &hdr)) != 0) {
+		struct RARHeaderDataSlim hdr;
+		if ((retval = RARReadHeaderSlim(rararc, &hdr)) != 0) {
 			break;
 		}
 		if ((hdr.Flags & 0xe0) == 0xe0) {
@@ -240,17 +394,57 @@ verify_rar(sqlite3 *db, char *path, HANDLE *rararc, int mode)
 		}
 		count++;
 		id = find_by_crc(db, hdr.UnpSize, hdr.FileCRC);
-		if (mode & SEARCH || mode & VERIFY || mode & COUNT) {
-			RARProcessFile(rararc, RAR_SKIP, NULL, NULL);
+		// RAR 5.0 members are matched from their headers, but can't
+		// be unpacked to be moved
+		if (mode & HUNT && id > 0 && hdr.UnpVer >= 50) {
+			fprintf(stderr, "error: can't extract %s from RAR 5.0 archive %s\n", hdr.FileName, path);
 		} else if (mode & HUNT && id > 0) {
-			struct rarinfo ri = {rararc, &hdr};
-			char *dest = archive_file(db, path, id, &move_rar, &ri, mode);
-			fprintf(stderr, "Move %s to %s\n", path, dest);
-			sqlite3_free(dest);
+			hits = (struct rarhit *)realloc(hits, (nhits + 1) * sizeof(struct rarhit));
+			hits[nhits].index = count - 1;
+			hits[nhits].id = id;
+			hits[nhits].crc = hdr.FileCRC;
+			hits[nhits].size = hdr.UnpSize;
+			hits[nhits].pos = hdr.HeaderPos;
+			nhits++;
 		}
 		if (mode & VERBOSE) {
-			fprintf(stdout, "RFile: %s/%s\t%s\n", path, hdr.FileName, id>0?"Found":"Unknown");
+			fprintf(out, "RFile: %s/%s\t%s\n", path, hdr.FileName, id>0?"Found":"Unknown");
 		}
+		// Skipping a member split over volumes fails if one is missing
+		if (RARProcessFile(rararc, RAR_SKIP, NULL, NULL) != 0) {
+			broken = 1;
+		}
+	}
+	if (out != stdout) {
+		fclose(out);
+	}
+	// A volume set that doesn't list to its end may have recovery
+	// volumes to rebuild the missing or damaged ones from.  Then it's
+	// verified again from the start, but only rebuilt once.
+	if ((broken || retval != ERAR_END_ARCHIVE) && !restored && rar_restore(path) == 0) {
+		HANDLE rebuilt;
+
+		fprintf(stderr, "Rebuilt volumes of %s from recovery volumes\n", path);
+		free(report);
+		free(hits);
+		if ((rebuilt = rar_open(path, 0)) == NULL) {
+			return count;
+		}
+		count = verify_rar(db, path, rebuilt, mode, 1);
+		rar_close(rebuilt);
+
+		return count;
+	}
+	if (report != NULL) {
+		fwrite(report, 1, reportlen, stdout);
+		free(report);
+	}
+	if (nhits > 0) {
+		hunt_rar(db, path, hits, nhits, mode);
+	}
+	free(hits);
+	if (mode & DEEP && rar_deep_verify(path, mode) == -1) {
+		fprintf(stderr, "error: couldn't read %s for deep verify\n", path);
 	}
 
 	return count;
@@ -269,7 +463,7 @@ find(sqlite3 *db, char *path, int mode)
 	int		count = 0;
 
 	if ((dir = opendir(path)) != NULL) {
-		while ((ent = readdir(dir)) != NULL) {
+		while (!interrupted && (ent = readdir(dir)) != NULL) {
 			if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
 				continue;
 			}
@@ -302,11 +496,11 @@ find(sqlite3 *db, char *path, int mode)
 					count += verify_zip(db, fname, ziparc, mode);
 				}
 				mz_zip_reader_end(ziparc);
-			} else if ((rararc = rar_open(fname, mode & HUNT)) != NULL) {
+			} else if ((rararc = rar_open(fname, 0)) != NULL) {
 				if (mode & COUNT) {
 					count += rar_get_num_files(rararc);
 				} else {
-					count += verify_rar(db, fname, rararc, mode);
+					count += verify_rar(db, fname, rararc, mode, 0);
 				}
 				rar_close(rararc);
 			} else {
@@ -328,11 +522,11 @@ find(sqlite3 *db, char *path, int mode)
 			count += verify_zip(db, path, ziparc, mode);
 		}
 		mz_zip_reader_end(ziparc);
-	} else if ((rararc = rar_open(path, mode & HUNT)) != NULL) {
+	} else if ((rararc = rar_open(path, 0)) != NULL) {
 		if (mode & COUNT) {
 			count += rar_get_num_files(rararc);
 		} else {
-			count += verify_rar(db, path, rararc, mode);
+			count += verify_rar(db, path, rararc, mode, 0);
 		}
 		rar_close(rararc);
 	} else {
@@ -10,6 +10,7 @@ Archive::Archive(RAROptions *InitCmd)
   Cmd=InitCmd==NULL ? &DummyCmd:InitCmd;
   OpenShared=Cmd->OpenShared;
   OldFormat=false;
+  Format50=false;
   Solid=false;
   Volume=false;
   MainComment=false;
@@ -105,6 +106,11 @@ ARCSIGN_TYPE Archive::IsSignature(const byte *D,size_t Size)
         // a sensible warning in case we'll want to change the archive
         // format sometimes in the future.
         Type=D[6]==0 ? ARCSIGN_CURRENT:ARCSIGN_FUTURE;
+#ifndef SFX_MODULE
+        // RAR 5.0 signature has one more zero byte, checked by IsArchive.
+        if (D[6]==1)
+          Type=ARCSIGN_50;
+#endif
       }
   return Type;
 }
@@ -157,6 +163,11 @@ bool Archive::IsArchive(bool EnableBroken)
     if (SFXSize==0)
       return false;
   }
+#ifndef SFX_MODULE
+  if (Type==ARCSIGN_50 && GetByte()!=0)
+    Type=ARCSIGN_FUTURE;
+  Format50=(Type==ARCSIGN_50);
+#endif
   if (Type==ARCSIGN_FUTURE)
   {
 #if !defined(SHELL_EXT) && !defined(SFX_MODULE)
@@ -173,6 +184,22 @@ bool Archive::IsArchive(bool EnableBroken)
     NewMhd.HeadSize=OldMhd.HeadSize;
   }
   else
+    if (Format50)
+    {
+      // ReadHeader50 checks the CRC itself. An encryption header in place
+      // of the main one means encrypted headers, which we can't read.
+      if (GetHeaderType()!=MAIN_HEAD)
+      {
+#ifndef SHELL_EXT
+        Log(FileName,St(MNewRarFormat));
+#endif
+#ifdef RARDLL
+        Cmd->DllError=ERAR_UNKNOWN_FORMAT;
+#endif
+        return(false);
+      }
+    }
+    else
 #endif
   {
     if (HeaderCRC!=NewMhd.HeadCRC)
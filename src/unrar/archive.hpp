@@ -5,7 +5,7 @@ class Pack;
 
 enum {EN_LOCK=1,EN_VOL=2,EN_FIRSTVOL=4};
 
-enum ARCSIGN_TYPE {ARCSIGN_NONE,ARCSIGN_OLD,ARCSIGN_CURRENT,ARCSIGN_FUTURE};
+enum ARCSIGN_TYPE {ARCSIGN_NONE,ARCSIGN_OLD,ARCSIGN_CURRENT,ARCSIGN_50,ARCSIGN_FUTURE};
 
 class Archive:public File
 {
@@ -16,6 +16,7 @@ class Archive:public File
     void ConvertNameCase(wchar *Name);
     void ConvertUnknownHeader();
     size_t ReadOldHeader();
+    size_t ReadHeader50();
     void UnexpEndArcMsg();
 
 #if !defined(SHELL_EXT) && !defined(RAR_NOCRYPT)
@@ -92,6 +93,7 @@ class Archive:public File
     int64 NextBlockPos;
 
     bool OldFormat;
+    bool Format50; // RAR 5.0, which is only listed.
     bool Solid;
     bool Volume;
     bool MainComment;
@@ -55,6 +55,8 @@ size_t Archive::ReadHeader()
 #ifndef SFX_MODULE
   if (OldFormat)
     return(ReadOldHeader());
+  if (Format50)
+    return(ReadHeader50());
 #endif
 
   RawRead Raw(this);
@@ -456,6 +458,8 @@ size_t Archive::ReadHeader()
         return(0);
       }
     }
+    else
+      HeadersCrypt.KeepKey();
   }
 
   if (NextBlockPos<=CurBlockPos)
@@ -529,6 +533,178 @@ size_t Archive::ReadOldHeader()
 #endif
 
 
+#ifndef SFX_MODULE
+// RAR 5.0 blocks are read only as far as listing files needs. File headers
+// are converted to the RAR 2.9 fields with UnpVer set to 50, so extraction
+// reports an unknown method for them instead of trying to unpack.
+size_t Archive::ReadHeader50()
+{
+  CurHeaderType=0;
+
+  // CRC32 and the header size, which takes up to 3 bytes. No block is
+  // shorter than 7 bytes.
+  RawRead Raw(this);
+  Raw.Read(7);
+  if (Raw.Size()<7)
+  {
+    UnexpEndArcMsg();
+    return(0);
+  }
+  uint HeadCRC;
+  Raw.Get(HeadCRC);
+  uint64 HeadSize=Raw.GetV();
+  size_t BlockSize=Raw.GetPos()+(size_t)HeadSize;
+  if (HeadSize<2 || HeadSize>0x200000 || Raw.GetPos()>7)
+  {
+#ifndef SHELL_EXT
+    Log(FileName,St(MLogFileHead),"???");
+#endif
+    BrokenFileHeader=true;
+    ErrHandler.SetErrorCode(RARX_CRC);
+    return(0);
+  }
+  Raw.Read(BlockSize-7);
+  if (Raw.Size()<BlockSize)
+  {
+    UnexpEndArcMsg();
+    return(0);
+  }
+  if (Raw.GetCRC50()!=HeadCRC)
+  {
+#ifndef SHELL_EXT
+    Log(FileName,St(MLogFileHead),"???");
+#endif
+    BrokenFileHeader=true;
+    ErrHandler.SetErrorCode(RARX_CRC);
+    return(0);
+  }
+
+  uint HeadType=(uint)Raw.GetV();
+  uint HeadFlags=(uint)Raw.GetV();
+  uint64 ExtraSize=(HeadFlags & 0x0001)!=0 ? Raw.GetV():0;
+  uint64 DataSize=(HeadFlags & 0x0002)!=0 ? Raw.GetV():0;
+  NextBlockPos=CurBlockPos+BlockSize+DataSize;
+
+  ShortBlock.HeadCRC=(ushort)HeadCRC;
+  ShortBlock.HeadType=(HEADER_TYPE)0;
+  ShortBlock.Flags=0;
+  ShortBlock.HeadSize=(ushort)Min(BlockSize,0xffff);
+  switch(HeadType)
+  {
+    case 1: // Main archive header.
+      {
+        uint ArcFlags=(uint)Raw.GetV();
+        ShortBlock.HeadType=MAIN_HEAD;
+        ShortBlock.Flags=MHD_NEWNUMBERING;
+        if (ArcFlags & 0x0001)
+          ShortBlock.Flags|=MHD_VOLUME;
+        if ((ArcFlags & 0x0002)==0) // No volume number.
+          ShortBlock.Flags|=MHD_FIRSTVOLUME;
+        if (ArcFlags & 0x0004)
+          ShortBlock.Flags|=MHD_SOLID;
+        if (ArcFlags & 0x0008)
+          ShortBlock.Flags|=MHD_PROTECT;
+        if (ArcFlags & 0x0010)
+          ShortBlock.Flags|=MHD_LOCK;
+        *(BaseBlock *)&NewMhd=ShortBlock;
+        NewMhd.HighPosAV=0;
+        NewMhd.PosAV=0;
+        NewMhd.EncryptVer=0;
+      }
+      break;
+    case 2: // File header.
+      {
+        uint FileFlags=(uint)Raw.GetV();
+        uint64 UnpSize=Raw.GetV();
+        NewLhd.FileAttr=(uint)Raw.GetV();
+        uint UnixTime=0;
+        if (FileFlags & 0x0002)
+          Raw.Get(UnixTime);
+        NewLhd.FileCRC=0;
+        if (FileFlags & 0x0004)
+          Raw.Get(NewLhd.FileCRC);
+        uint CompInfo=(uint)Raw.GetV();
+        uint HostOS=(uint)Raw.GetV();
+        size_t NameSize=(size_t)Raw.GetV();
+
+        char FileName[NM*4];
+        size_t NameRead=Min(NameSize,sizeof(FileName)-1);
+        Raw.Get((byte *)FileName,NameRead);
+        FileName[NameRead]=0;
+
+        ShortBlock.HeadType=FILE_HEAD;
+        ShortBlock.Flags=LONG_BLOCK|LHD_UNICODE;
+        if (HeadFlags & 0x0008)
+          ShortBlock.Flags|=LHD_SPLIT_BEFORE;
+        if (HeadFlags & 0x0010)
+          ShortBlock.Flags|=LHD_SPLIT_AFTER;
+        if (FileFlags & 0x0001)
+          ShortBlock.Flags|=LHD_DIRECTORY;
+        if (CompInfo & 0x0040)
+          ShortBlock.Flags|=LHD_SOLID;
+
+        // Extra area records are size, type and data. Only encryption
+        // matters for listing.
+        if (ExtraSize>0 && ExtraSize<BlockSize)
+        {
+          Raw.SetPos(BlockSize-(size_t)ExtraSize);
+          while (Raw.GetPos()<BlockSize)
+          {
+            size_t RecSize=(size_t)Raw.GetV();
+            size_t RecPos=Raw.GetPos();
+            if (RecSize==0 || RecPos+RecSize>BlockSize)
+              break;
+            if (Raw.GetV()==0x01)
+              ShortBlock.Flags|=LHD_PASSWORD;
+            Raw.SetPos(RecPos+RecSize);
+          }
+        }
+
+        *(BaseBlock *)&NewLhd=ShortBlock;
+        NewLhd.FullPackSize=DataSize;
+        NewLhd.PackSize=(uint)DataSize;
+        NewLhd.HighPackSize=(uint)(DataSize>>32);
+        NewLhd.FullUnpSize=(FileFlags & 0x0008)!=0 ? INT64NDF:UnpSize;
+        NewLhd.UnpSize=(uint)NewLhd.FullUnpSize;
+        NewLhd.HighUnpSize=(uint)(NewLhd.FullUnpSize>>32);
+        NewLhd.HostOS=HostOS==0 ? HOST_WIN32:HostOS==1 ? HOST_UNIX:HOST_MAX;
+        NewLhd.UnpVer=50;
+        NewLhd.Method=0x30+((CompInfo>>7) & 7);
+        NewLhd.NameSize=(ushort)Min(NameSize,0xffff);
+
+        UtfToWide(FileName,NewLhd.FileNameW,ASIZE(NewLhd.FileNameW)-1);
+        WideToChar(NewLhd.FileNameW,NewLhd.FileName,ASIZE(NewLhd.FileName)-1);
+        ExtToInt(NewLhd.FileName,NewLhd.FileName);
+        ConvertNameCase(NewLhd.FileName);
+        ConvertNameCase(NewLhd.FileNameW);
+        ConvertUnknownHeader();
+
+        NewLhd.mtime.Reset();
+#if defined(_UNIX) || defined(_EMX)
+        if (FileFlags & 0x0002)
+          NewLhd.mtime=(time_t)UnixTime;
+#endif
+        NewLhd.FileTime=NewLhd.mtime.IsSet() ? NewLhd.mtime.GetDos():0;
+        NewLhd.ctime.Reset();
+        NewLhd.atime.Reset();
+        NewLhd.arctime.Reset();
+      }
+      break;
+    case 5: // End of archive.
+      ShortBlock.HeadType=ENDARC_HEAD;
+      if (Raw.GetV() & 0x0001)
+        ShortBlock.Flags=EARC_NEXT_VOLUME;
+      *(BaseBlock *)&EndArcHead=ShortBlock;
+      break;
+  }
+  // Service and encryption headers are left with type 0, which nothing
+  // here looks for.
+  CurHeaderType=ShortBlock.HeadType;
+  return(Raw.Size());
+}
+#endif
+
+
 void Archive::ConvertNameCase(char *Name)
 {
   if (Cmd->ConvertNames==NAMES_UPPERCASE)
@@ -569,6 +745,20 @@ bool Archive::IsArcLabel()
 }
 
 
+#ifdef _UNIX
+static mode_t GetProcessUmask()
+{
+  // umask call returns the current umask value. Argument (022) is not 
+  // really important here.
+  mode_t mask = umask(022);
+
+  // Restore the original umask value, which was changed to 022 above.
+  umask(mask);
+  return(mask);
+}
+#endif
+
+
 void Archive::ConvertAttributes()
 {
 #if defined(_WIN_ALL) || defined(_EMX)
@@ -598,17 +788,9 @@ void Archive::ConvertAttributes()
   // when creating a file or directory. The typical default value
   // for the process umask is S_IWGRP | S_IWOTH (octal 022),
   // resulting in 0644 mode for new files.
-  static mode_t mask = (mode_t) -1;
-
-  if (mask == (mode_t) -1)
-  {
-    // umask call returns the current umask value. Argument (022) is not 
-    // really important here.
-    mask = umask(022);
-
-    // Restore the original umask value, which was changed to 022 above.
-    umask(mask);
-  }
+  // Querying umask briefly changes it, so only the first thread to get
+  // here may do it. Local statics are initialized exactly once.
+  static mode_t mask = GetProcessUmask();
 
   switch(NewLhd.HostOS)
   {
@@ -30,7 +30,7 @@ void InitCRC()
     CRCTab[I]=crc_tables[0][I]=C;
   }
 
-	for (uint I=0;I<=256;I++) // Build additional lookup tables.
+	for (uint I=0;I<256;I++) // Build additional lookup tables.
   {
 		uint C=crc_tables[0][I];
 		for (uint J=1;J<8;J++)
@@ -42,10 +42,16 @@ void InitCRC()
 }
 
 
+// Build the tables once at startup. Filling them lazily on first use let
+// a thread read them while another one was still writing.
+static struct CallInitCRC
+{
+  CallInitCRC() {InitCRC();}
+} CallInit32;
+
+
 uint CRC(uint StartCRC,const void *Addr,size_t Size)
 {
-  if (CRCTab[1]==0)
-    InitCRC();
   byte *Data=(byte *)Addr;
 
   // Align Data to 8 for better performance.
@@ -76,6 +82,47 @@ uint CRC(uint StartCRC,const void *Addr,size_t Size)
 }
 
 
+// Same as CRC(), but also copies Src to Dest in the same pass, so data
+// unpacked to memory is read only once.
+uint CRCCopy(uint StartCRC,void *Dest,const void *Src,size_t Size)
+{
+  byte *Data=(byte *)Src,*Out=(byte *)Dest;
+
+  for (;Size>0 && ((long)Data & 7);Size--,Data++,Out++)
+  {
+    *Out=Data[0];
+    StartCRC=crc_tables[0][(byte)(StartCRC^Data[0])]^(StartCRC>>8);
+  }
+
+  for (;Size>=8;Size-=8,Data+=8,Out+=8)
+  {
+    uint64 Word=*(uint64 *)Data;
+    memcpy(Out,&Word,8);
+#ifdef BIG_ENDIAN
+    StartCRC ^= Data[0]|(Data[1] << 8)|(Data[2] << 16)|(Data[3] << 24);
+#else
+    StartCRC ^= (uint32)Word;
+#endif
+    StartCRC = crc_tables[7][(byte) StartCRC       ] ^
+               crc_tables[6][(byte)(StartCRC >> 8) ] ^
+               crc_tables[5][(byte)(StartCRC >> 16)] ^
+               crc_tables[4][(byte)(StartCRC >> 24)] ^
+               crc_tables[3][Data[4]] ^
+               crc_tables[2][Data[5]] ^
+               crc_tables[1][Data[6]] ^
+               crc_tables[0][Data[7]];
+  }
+
+  for (;Size>0;Size--,Data++,Out++)
+  {
+    *Out=Data[0];
+    StartCRC=crc_tables[0][(byte)(StartCRC^Data[0])]^(StartCRC>>8);
+  }
+
+  return(StartCRC);
+}
+
+
 #ifndef SFX_MODULE
 // For RAR 1.4 archives in case somebody still has them.
 ushort OldCRC(ushort StartCRC,const void *Addr,size_t Size)
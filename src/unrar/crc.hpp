@@ -3,6 +3,7 @@
 
 void InitCRC();
 uint CRC(uint StartCRC,const void *Addr,size_t Size);
+uint CRCCopy(uint StartCRC,void *Dest,const void *Src,size_t Size);
 ushort OldCRC(ushort StartCRC,const void *Addr,size_t Size);
 
 #endif
@@ -14,8 +14,14 @@ extern uint CRCTab[256];
            ((uint)SubstTable[(int)(t>>16)&255]<<16) | \
            ((uint)SubstTable[(int)(t>>24)&255]<<24) )
 
-CryptKeyCacheItem CryptData::Cache[4];
-int CryptData::CachePos=0;
+// Each thread keeps its own key cache, so handles opened on different
+// threads never share it.
+thread_local CryptKeyCacheItem CryptData::Cache[4];
+thread_local int CryptData::CachePos=0;
+
+// Set by the application before any archive is opened and shared by all
+// threads, so the store has to do its own locking.
+RARKeyStore *CryptData::KeyStore=NULL;
 
 
 #ifndef SFX_MODULE
@@ -187,6 +193,7 @@ void CryptData::Swap(byte *Ch1,byte *Ch2)
 
 void CryptData::SetCryptKeys(SecPassword *Password,const byte *Salt,bool Encrypt,bool OldOnly,bool HandsOffHash)
 {
+  KeyPending=false;
   if (!Password->IsSet())
     return;
   wchar PlainPsw[MAXPASSWORD];
@@ -194,8 +201,6 @@ void CryptData::SetCryptKeys(SecPassword *Password,const byte *Salt,bool Encrypt
   if (OldOnly)
   {
 #ifndef SFX_MODULE
-    if (CRCTab[1]==0)
-      InitCRC();
     char Psw[MAXPASSWORD];
     memset(Psw,0,sizeof(Psw));
 
@@ -251,31 +256,54 @@ void CryptData::SetCryptKeys(SecPassword *Password,const byte *Salt,bool Encrypt
       memcpy(RawPsw+RawLength,Salt,SALT_SIZE);
       RawLength+=SALT_SIZE;
     }
-    hash_context c;
-    hash_initial(&c);
 
-    const int HashRounds=0x40000;
-    for (int I=0;I<HashRounds;I++)
+    bool Stored=false;
+    if (KeyStore!=NULL)
     {
-      hash_process( &c, RawPsw, RawLength, HandsOffHash);
-      byte PswNum[3];
-      PswNum[0]=(byte)I;
-      PswNum[1]=(byte)(I>>8);
-      PswNum[2]=(byte)(I>>16);
-      hash_process( &c, PswNum, 3, HandsOffHash);
-      if (I%(HashRounds/16)==0)
+      KeyStoreId(RawPsw,RawLength,HandsOffHash,PendingId);
+      if (KeyStore->Find(KeyStore->Opaque,PendingId,PendingKey))
       {
-        hash_context tempc=c;
-        uint32 digest[5];
-        hash_final( &tempc, digest, HandsOffHash);
-        AESInit[I/(HashRounds/16)]=(byte)digest[4];
+        memcpy(AESKey,PendingKey,sizeof(AESKey));
+        memcpy(AESInit,PendingKey+sizeof(AESKey),sizeof(AESInit));
+        Stored=true;
+      }
+    }
+
+    if (!Stored)
+    {
+      hash_context c;
+      hash_initial(&c);
+
+      const int HashRounds=0x40000;
+      for (int I=0;I<HashRounds;I++)
+      {
+        hash_process( &c, RawPsw, RawLength, HandsOffHash);
+        byte PswNum[3];
+        PswNum[0]=(byte)I;
+        PswNum[1]=(byte)(I>>8);
+        PswNum[2]=(byte)(I>>16);
+        hash_process( &c, PswNum, 3, HandsOffHash);
+        if (I%(HashRounds/16)==0)
+        {
+          hash_context tempc=c;
+          uint32 digest[5];
+          hash_final( &tempc, digest, HandsOffHash);
+          AESInit[I/(HashRounds/16)]=(byte)digest[4];
+        }
+      }
+      uint32 digest[5];
+      hash_final( &c, digest, HandsOffHash);
+      for (int I=0;I<4;I++)
+        for (int J=0;J<4;J++)
+          AESKey[I*4+J]=(byte)(digest[I]>>(J*8));
+
+      if (KeyStore!=NULL)
+      {
+        memcpy(PendingKey,AESKey,sizeof(AESKey));
+        memcpy(PendingKey+sizeof(AESKey),AESInit,sizeof(AESInit));
+        KeyPending=true;
       }
     }
-    uint32 digest[5];
-    hash_final( &c, digest, HandsOffHash);
-    for (int I=0;I<4;I++)
-      for (int J=0;J<4;J++)
-        AESKey[I*4+J]=(byte)(digest[I]>>(J*8));
 
     Cache[CachePos].Password=*Password;
     if ((Cache[CachePos].SaltPresent=(Salt!=NULL))==true)
@@ -292,6 +320,54 @@ void CryptData::SetCryptKeys(SecPassword *Password,const byte *Salt,bool Encrypt
 }
 
 
+// Key store entries are looked up by an HMAC-SHA1 of the password and
+// salt keyed with the store's secret. Without the secret an entry can't be
+// matched to a password, but with it a guess costs one HMAC rather than
+// the 0x40000 rounds deriving the key takes.
+void CryptData::KeyStoreId(const byte *RawPsw,size_t RawLength,bool HandsOffHash,byte *Id)
+{
+  byte Pad[64];
+  memset(Pad,0,sizeof(Pad));
+  memcpy(Pad,KeyStore->Secret,Min(KeyStore->SecretSize,sizeof(Pad)));
+
+  hash_context c;
+  uint32 digest[5];
+  for (int I=0;I<2;I++)
+  {
+    for (size_t J=0;J<sizeof(Pad);J++)
+      Pad[J]^=I==0 ? 0x36:0x36^0x5c;
+    hash_initial(&c);
+    hash_process(&c,Pad,sizeof(Pad),true);
+    if (I==0)
+    {
+      hash_process(&c,(byte *)RawPsw,RawLength,true);
+      byte Flags=HandsOffHash ? 1:0;
+      hash_process(&c,&Flags,1,true);
+    }
+    else
+      hash_process(&c,Id,20,true);
+    hash_final(&c,digest,true);
+    for (int K=0;K<5;K++)
+      for (int J=0;J<4;J++)
+        Id[K*4+J]=(byte)(digest[K]>>(24-J*8));
+  }
+  cleandata(&c,sizeof(c));
+  cleandata(Pad,sizeof(Pad));
+  cleandata(digest,sizeof(digest));
+}
+
+
+// Called once data or a header decrypted with the current keys passed its
+// CRC check, so a key derived for a wrong password never gets stored.
+void CryptData::KeepKey()
+{
+  if (KeyPending && KeyStore!=NULL)
+    KeyStore->Put(KeyStore->Opaque,PendingId,PendingKey);
+  KeyPending=false;
+  cleandata(PendingKey,sizeof(PendingKey));
+}
+
+
 #ifndef SFX_MODULE
 void CryptData::SetOldKeys(const char *Password)
 {
@@ -35,6 +35,7 @@ class CryptData
     void UpdKeys(byte *Buf);
     void Swap(byte *Ch1,byte *Ch2);
     void SetOldKeys(const char *Password);
+    static void KeyStoreId(const byte *RawPsw,size_t RawLength,bool HandsOffHash,byte *Id);
 
     Rijndael rin;
     
@@ -45,10 +46,20 @@ class CryptData
 
     byte AESKey[16],AESInit[16];
 
-    static CryptKeyCacheItem Cache[4];
-    static int CachePos;
+    // A key derived for the key store, held back until the password
+    // proves right.
+    bool KeyPending;
+    byte PendingId[20],PendingKey[32];
+
+    static thread_local CryptKeyCacheItem Cache[4];
+    static thread_local int CachePos;
   public:
+    CryptData() {KeyPending=false;}
+    ~CryptData() {cleandata(PendingKey,sizeof(PendingKey));}
+    static RARKeyStore *KeyStore;
+
     void SetCryptKeys(SecPassword *Password,const byte *Salt,bool Encrypt,bool OldOnly,bool HandsOffHash);
+    void KeepKey();
     void SetAV15Encryption();
     void SetCmt13Encryption();
     void EncryptBlock20(byte *Buf);
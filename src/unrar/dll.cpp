@@ -3,6 +3,8 @@
 
 static int RarErrorToDll(RAR_EXIT ErrCode);
 
+struct DataSetPool;
+
 struct DataSet
 {
   CommandData Cmd;
@@ -10,11 +12,53 @@ struct DataSet
   Archive Arc;
   int OpenMode;
   int HeaderSize;
+  DataSetPool *Pool; // Pool to return to on RARReleaseArchive, or NULL.
+  char FileNameUtf[NM*4]; // RARReadHeaderSlim name converted from Unicode.
+  byte ReadAhead[0x10000]; // Archive read-ahead buffer.
+  VolumePrefetch Prefetch; // Next volume for extraction handles.
+  uint UnpCRC; // CRC32 of the file last unpacked by ProcessFile.
+  int64 UnpSize; // Bytes of it unpacked.
+  bool UnpWhole; // UnpSize matched the size in the header.
+
+  DataSet():Arc(&Cmd) {Pool=NULL;};
+  void Reset();
+};
+
+
+// Bring a released DataSet back to the state of a new one, keeping
+// the unpacker and its window allocated.
+void DataSet::Reset()
+{
+  Cmd.Init();
+  Extract.Reset();
+  Arc.~Archive();
+  new (&Arc) Archive(&Cmd);
+  OpenMode=0;
+  HeaderSize=0;
+}
 
-  DataSet():Arc(&Cmd) {};
+
+// Released DataSets waiting for reuse. A pool isn't locked, so every
+// thread opening archives through it needs its own.
+struct DataSetPool
+{
+  Array<DataSet *> Free;
 };
 
 
+static void FreeDataSet(DataSet *Data)
+{
+  if (Data->Pool!=NULL)
+  {
+    Data->Arc.Close();
+    Data->Prefetch.Stop();
+    Data->Pool->Free.Push(Data);
+  }
+  else
+    delete Data;
+}
+
+
 HANDLE PASCAL RAROpenArchive(struct RAROpenArchiveData *r)
 {
   RAROpenArchiveDataEx rx;
@@ -31,13 +75,23 @@ HANDLE PASCAL RAROpenArchive(struct RAROpenArchiveData *r)
 }
 
 
-HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx *r)
+static HANDLE OpenArchive(struct RAROpenArchiveDataEx *r,DataSetPool *Pool)
 {
   DataSet *Data=NULL;
   try
   {
     r->OpenResult=0;
-    Data=new DataSet;
+    if (Pool!=NULL && Pool->Free.Size()>0)
+    {
+      Data=Pool->Free[Pool->Free.Size()-1];
+      Pool->Free.Alloc(Pool->Free.Size()-1);
+      Data->Reset();
+    }
+    else
+    {
+      Data=new DataSet;
+      Data->Pool=Pool;
+    }
     Data->Cmd.DllError=0;
     Data->OpenMode=r->OpenMode;
     Data->Cmd.FileArgs->AddString("*");
@@ -56,19 +110,27 @@ HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx *r)
     Data->Cmd.Callback=r->Callback;
     Data->Cmd.UserData=r->UserData;
 
+    Data->Arc.SetReadAhead(Data->ReadAhead,sizeof(Data->ReadAhead));
     if (!Data->Arc.Open(r->ArcName,r->ArcNameW,0))
     {
       r->OpenResult=ERAR_EOPEN;
-      delete Data;
+      FreeDataSet(Data);
       return(NULL);
     }
     if (!Data->Arc.IsArchive(false))
     {
       r->OpenResult=Data->Cmd.DllError!=0 ? Data->Cmd.DllError:ERAR_BAD_ARCHIVE;
-      delete Data;
+      FreeDataSet(Data);
       return(NULL);
     }
     r->Flags=Data->Arc.NewMhd.Flags;
+    if (Data->OpenMode==RAR_OM_EXTRACT && Data->Arc.Volume)
+    {
+      // Decoding only stalls on a volume switch when extracting, and
+      // listings don't need more than the headers.
+      Data->Cmd.VolPrefetch=&Data->Prefetch;
+      Data->Prefetch.Start(Data->Arc);
+    }
     Array<byte> CmtData;
     if (r->CmtBufSize!=0 && Data->Arc.GetComment(&CmtData,NULL))
     {
@@ -94,18 +156,56 @@ HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx *r)
     else
       r->OpenResult=RarErrorToDll(ErrCode);
     if (Data != NULL)
-      delete Data;
+      FreeDataSet(Data);
     return(NULL);
   }
   catch (std::bad_alloc) // Catch 'new' exception.
   {
     r->OpenResult=ERAR_NO_MEMORY;
     if (Data != NULL)
-      delete Data;
+      FreeDataSet(Data);
+    return(NULL);
+  }
+}
+
+
+HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx *r)
+{
+  return(OpenArchive(r,NULL));
+}
+
+
+HANDLE PASCAL RARCreatePool()
+{
+  try
+  {
+    return((HANDLE)new DataSetPool);
+  }
+  catch (std::bad_alloc)
+  {
+    return(NULL);
   }
 }
 
 
+// All archives opened from the pool must be released or closed first.
+void PASCAL RARDestroyPool(HANDLE hPool)
+{
+  DataSetPool *Pool=(DataSetPool *)hPool;
+  if (Pool==NULL)
+    return;
+  for (size_t I=0;I<Pool->Free.Size();I++)
+    delete Pool->Free[I];
+  delete Pool;
+}
+
+
+HANDLE PASCAL RAROpenArchivePooled(HANDLE hPool,struct RAROpenArchiveDataEx *r)
+{
+  return(OpenArchive(r,(DataSetPool *)hPool));
+}
+
+
 int PASCAL RARCloseArchive(HANDLE hArcData)
 {
   DataSet *Data=(DataSet *)hArcData;
@@ -115,6 +215,19 @@ int PASCAL RARCloseArchive(HANDLE hArcData)
 }
 
 
+// Like RARCloseArchive, but a handle from RAROpenArchivePooled goes back
+// to its pool for the next RAROpenArchivePooled instead of being freed.
+int PASCAL RARReleaseArchive(HANDLE hArcData)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  if (Data==NULL)
+    return(ERAR_ECLOSE);
+  bool Success=Data->Arc.Close();
+  FreeDataSet(Data);
+  return(Success ? 0:ERAR_ECLOSE);
+}
+
+
 int PASCAL RARReadHeader(HANDLE hArcData,struct RARHeaderData *D)
 {
   struct RARHeaderDataEx X;
@@ -140,10 +253,12 @@ int PASCAL RARReadHeader(HANDLE hArcData,struct RARHeaderData *D)
 }
 
 
-int PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *D)
+// Position the archive at the next file header, moving to the next volume
+// at the end of this one and, in list mode, skipping the parts of files
+// continued from a previous volume.
+static int NextFileHeader(DataSet *Data)
 {
-  DataSet *Data=(DataSet *)hArcData;
-  try
+  while (true)
   {
     if ((Data->HeaderSize=(int)Data->Arc.SearchBlock(FILE_HEAD))<=0)
     {
@@ -153,7 +268,7 @@ int PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *D)
         {
           Data->Extract.SignatureFound=false;
           Data->Arc.Seek(Data->Arc.CurBlockPos,SEEK_SET);
-          return(RARReadHeaderEx(hArcData,D));
+          continue;
         }
         else
           return(ERAR_EOPEN);
@@ -161,12 +276,24 @@ int PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *D)
     }
     if (Data->OpenMode==RAR_OM_LIST && (Data->Arc.NewLhd.Flags & LHD_SPLIT_BEFORE)!=0)
     {
-      int Code=RARProcessFile(hArcData,RAR_SKIP,NULL,NULL);
-      if (Code==0)
-        return(RARReadHeaderEx(hArcData,D));
-      else
+      int Code=RARProcessFile((HANDLE)Data,RAR_SKIP,NULL,NULL);
+      if (Code!=0)
         return(Code);
+      continue;
     }
+    return(0);
+  }
+}
+
+
+int PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *D)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  try
+  {
+    int Code=NextFileHeader(Data);
+    if (Code!=0)
+      return(Code);
     strncpyz(D->ArcName,Data->Arc.FileName,ASIZE(D->ArcName));
     if (*Data->Arc.FileNameW)
       wcsncpy(D->ArcNameW,Data->Arc.FileNameW,ASIZE(D->ArcNameW));
@@ -209,6 +336,81 @@ int PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *D)
 }
 
 
+// Same as RARReadHeaderEx without filling the large RARHeaderDataEx.
+// FileName points into the handle and stays valid until the next call.
+int PASCAL RARReadHeaderSlim(HANDLE hArcData,struct RARHeaderDataSlim *D)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  try
+  {
+    int Code=NextFileHeader(Data);
+    if (Code!=0)
+      return(Code);
+    FileHeader *hd=&Data->Arc.NewLhd;
+    if (*hd->FileNameW)
+    {
+      WideToUtf(hd->FileNameW,Data->FileNameUtf,ASIZE(Data->FileNameUtf));
+      D->FileName=Data->FileNameUtf;
+    }
+    else
+      D->FileName=hd->FileName;
+    D->PackSize=hd->FullPackSize;
+    D->UnpSize=hd->FullUnpSize;
+    D->Flags=hd->Flags;
+    D->HostOS=hd->HostOS;
+    D->FileCRC=hd->FileCRC;
+    D->FileTime=hd->FileTime;
+    D->UnpVer=hd->UnpVer;
+    D->Method=hd->Method;
+    D->FileAttr=hd->FileAttr;
+    bool Solid=(hd->Flags & LHD_SOLID)!=0 || Data->Arc.Solid && hd->UnpVer<=15;
+    bool Unpackable=hd->UnpVer<=UNP_VER;
+    D->HeaderPos=Solid || Data->Arc.Volume || !Unpackable ? ~0ULL:Data->Arc.CurBlockPos;
+  }
+  catch (RAR_EXIT ErrCode)
+  {
+    return(Data->Cmd.DllError!=0 ? Data->Cmd.DllError:RarErrorToDll(ErrCode));
+  }
+  return(0);
+}
+
+
+// Move to the file header at HeaderPos, as reported by RARReadHeaderSlim
+// on any handle for the same archive, so the next RARReadHeaderSlim reads
+// it. Files that can be unpacked on their own can be processed in any
+// order this way, each thread with its own handle.
+int PASCAL RARSeekHeader(HANDLE hArcData,unsigned long long HeaderPos)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  if (HeaderPos==~0ULL || Data->Arc.Volume)
+    return(ERAR_UNKNOWN);
+  try
+  {
+    Data->Arc.Seek(HeaderPos,SEEK_SET);
+  }
+  catch (RAR_EXIT ErrCode)
+  {
+    return(Data->Cmd.DllError!=0 ? Data->Cmd.DllError:RarErrorToDll(ErrCode));
+  }
+  return(0);
+}
+
+
+// Wide name of the file header last read, for callers that want it.
+int PASCAL RARGetFileNameW(HANDLE hArcData,wchar_t *NameW,int MaxSize)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  if (MaxSize<=0)
+    return(ERAR_SMALL_BUF);
+  if (*Data->Arc.NewLhd.FileNameW)
+    wcsncpyz(NameW,Data->Arc.NewLhd.FileNameW,MaxSize);
+  else
+    if (!CharToWide(Data->Arc.NewLhd.FileName,NameW,MaxSize))
+      *NameW=0;
+  return(0);
+}
+
+
 int PASCAL ProcessFile(HANDLE hArcData,int Operation,char *DestPath,char *DestName,wchar *DestPathW,wchar *DestNameW)
 {
   DataSet *Data=(DataSet *)hArcData;
@@ -275,6 +477,21 @@ int PASCAL ProcessFile(HANDLE hArcData,int Operation,char *DestPath,char *DestNa
       bool Repeat=false;
       Data->Extract.ExtractCurrentFile(&Data->Cmd,Data->Arc,Data->HeaderSize,Repeat);
 
+      // Only the file data goes to a sink or memory, not the extra blocks
+      // after it.
+      RARDataSink *Sink=Data->Cmd.DataSink;
+      Data->Cmd.DataSink=NULL;
+      ComprDataIO *DataIO=Data->Extract.GetDataIO();
+      DataIO->ResetUnpackToMemory();
+      Data->UnpCRC=DataIO->UnpFileCRC;
+      if (!Data->Arc.OldFormat)
+        Data->UnpCRC^=0xffffffff;
+      Data->UnpSize=DataIO->CurUnpWrite;
+      Data->UnpWhole=Data->UnpSize==Data->Arc.NewLhd.FullUnpSize;
+      if (Sink!=NULL && Sink->Finish!=NULL && Data->UnpWhole &&
+          Sink->Finish(Sink->Opaque,Data->UnpCRC)==0)
+        ErrHandler.Exit(RARX_USERBREAK);
+
       // Now we process extra file information if any.
       //
       // Archive can be closed if we process volumes, next volume is missing
@@ -311,6 +528,41 @@ int PASCAL RARProcessFileW(HANDLE hArcData,int Operation,wchar *DestPath,wchar *
 }
 
 
+// Test the current file, handing its data to Sink as it is unpacked
+// instead of writing it anywhere.
+int PASCAL RARProcessFileToSink(HANDLE hArcData,struct RARDataSink *Sink)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  if (Data->OpenMode==RAR_OM_LIST || Data->OpenMode==RAR_OM_LIST_INCSPLIT)
+    return(ERAR_UNKNOWN);
+  Data->Cmd.DataSink=Sink;
+  int Code=ProcessFile(hArcData,RAR_TEST,NULL,NULL,NULL,NULL);
+  Data->Cmd.DataSink=NULL;
+  return(Code);
+}
+
+
+// Test the current file, unpacking it into Buf, which must hold the whole
+// file. The data is copied out of the unpack window in the same pass that
+// updates its CRC, and FileCRC, if not NULL, gets the CRC32 of it.
+int PASCAL RARProcessFileToMem(HANDLE hArcData,unsigned char *Buf,size_t Size,unsigned int *FileCRC)
+{
+  DataSet *Data=(DataSet *)hArcData;
+  if (Data->OpenMode==RAR_OM_LIST || Data->OpenMode==RAR_OM_LIST_INCSPLIT)
+    return(ERAR_UNKNOWN);
+  ComprDataIO *DataIO=Data->Extract.GetDataIO();
+  DataIO->SetUnpackToMemory(Buf,Size);
+  Data->UnpWhole=false;
+  int Code=ProcessFile(hArcData,RAR_TEST,NULL,NULL,NULL,NULL);
+  DataIO->ResetUnpackToMemory();
+  if (Code==0 && (!Data->UnpWhole || Data->UnpSize>(int64)Size))
+    Code=ERAR_BAD_DATA;
+  if (Code==0 && FileCRC!=NULL)
+    *FileCRC=Data->UnpCRC;
+  return(Code);
+}
+
+
 void PASCAL RARSetChangeVolProc(HANDLE hArcData,CHANGEVOLPROC ChangeVolProc)
 {
   DataSet *Data=(DataSet *)hArcData;
@@ -342,9 +594,38 @@ void PASCAL RARSetPassword(HANDLE hArcData,char *Password)
   Data->Cmd.Password.Set(PasswordW);
   cleandata(PasswordW,sizeof(PasswordW));
 }
+
+
+void PASCAL RARSetKeyStore(struct RARKeyStore *Store)
+{
+  CryptData::KeyStore=Store;
+}
 #endif
 
 
+// Rebuild missing or damaged volumes of the set ArcName belongs to from its
+// .rev recovery volumes. Damaged volumes are renamed to .bad first.
+int PASCAL RARRestoreVolumes(char *ArcName)
+{
+  try
+  {
+    CommandData Cmd;
+    wchar ArcNameW[NM];
+    GetWideName(ArcName,NULL,ArcNameW,ASIZE(ArcNameW));
+    RecVolumes RecVol;
+    return(RecVol.Restore(&Cmd,ArcName,ArcNameW,true) ? 0:ERAR_BAD_DATA);
+  }
+  catch (RAR_EXIT ErrCode)
+  {
+    return(RarErrorToDll(ErrCode));
+  }
+  catch (std::bad_alloc)
+  {
+    return(ERAR_NO_MEMORY);
+  }
+}
+
+
 int PASCAL RARGetDllVersion()
 {
   return(RAR_DLL_VERSION);
@@ -84,6 +84,25 @@ struct RARHeaderDataEx
 };
 
 
+struct RARHeaderDataSlim
+{
+  const char   *FileName;
+  unsigned long long PackSize;
+  unsigned long long UnpSize;
+  unsigned int Flags;
+  unsigned int HostOS;
+  unsigned int FileCRC;
+  unsigned int FileTime;
+  unsigned int UnpVer;
+  unsigned int Method;
+  unsigned int FileAttr;
+  // Where RARSeekHeader can find this header again, or ~0 if the file
+  // can't be unpacked on its own: it is solid, in a volume set or in
+  // a RAR 5.0 archive, which are only listed.
+  unsigned long long HeaderPos;
+};
+
+
 struct RAROpenArchiveData
 {
   char         *ArcName;
@@ -121,6 +140,33 @@ enum UNRARCALLBACK_MESSAGES {
 typedef int (PASCAL *CHANGEVOLPROC)(char *ArcName,int Mode);
 typedef int (PASCAL *PROCESSDATAPROC)(unsigned char *Addr,int Size);
 
+// Destination for RARProcessFileToSink. Write gets the unpacked data
+// straight from the unpack window, in pieces of up to the window size.
+// Finish gets the CRC32 of everything written once the whole file has
+// been unpacked. Returning 0 from either stops the extraction.
+struct RARDataSink
+{
+  int (PASCAL *Write)(void *Opaque,const unsigned char *Data,size_t Size);
+  int (PASCAL *Finish)(void *Opaque,unsigned int FileCRC);
+  void *Opaque;
+};
+
+// Keeps AES keys derived from a password and salt between handles and
+// runs, since deriving one takes 0x40000 SHA1 rounds. Id is an HMAC-SHA1
+// of the password and salt keyed with Secret, of up to 64 bytes, Key the
+// 16 byte key followed by the 16 byte initialization vector. Find returns
+// 0 if it has no key for Id. Both may be called from any thread that
+// unpacks. Anyone who has both the Secret and the entries can test a
+// password guess against them at the cost of one HMAC.
+struct RARKeyStore
+{
+  int (PASCAL *Find)(void *Opaque,const unsigned char *Id,unsigned char *Key);
+  void (PASCAL *Put)(void *Opaque,const unsigned char *Id,const unsigned char *Key);
+  void *Opaque;
+  const unsigned char *Secret;
+  size_t SecretSize;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -128,14 +174,25 @@ extern "C" {
 HANDLE PASCAL RAROpenArchive(struct RAROpenArchiveData *ArchiveData);
 HANDLE PASCAL RAROpenArchiveEx(struct RAROpenArchiveDataEx *ArchiveData);
 int    PASCAL RARCloseArchive(HANDLE hArcData);
+HANDLE PASCAL RARCreatePool();
+void   PASCAL RARDestroyPool(HANDLE hPool);
+HANDLE PASCAL RAROpenArchivePooled(HANDLE hPool,struct RAROpenArchiveDataEx *ArchiveData);
+int    PASCAL RARReleaseArchive(HANDLE hArcData);
 int    PASCAL RARReadHeader(HANDLE hArcData,struct RARHeaderData *HeaderData);
 int    PASCAL RARReadHeaderEx(HANDLE hArcData,struct RARHeaderDataEx *HeaderData);
+int    PASCAL RARReadHeaderSlim(HANDLE hArcData,struct RARHeaderDataSlim *HeaderData);
+int    PASCAL RARSeekHeader(HANDLE hArcData,unsigned long long HeaderPos);
+int    PASCAL RARGetFileNameW(HANDLE hArcData,wchar_t *NameW,int MaxSize);
 int    PASCAL RARProcessFile(HANDLE hArcData,int Operation,char *DestPath,char *DestName);
 int    PASCAL RARProcessFileW(HANDLE hArcData,int Operation,wchar_t *DestPath,wchar_t *DestName);
+int    PASCAL RARProcessFileToSink(HANDLE hArcData,struct RARDataSink *Sink);
+int    PASCAL RARProcessFileToMem(HANDLE hArcData,unsigned char *Buf,size_t Size,unsigned int *FileCRC);
 void   PASCAL RARSetCallback(HANDLE hArcData,UNRARCALLBACK Callback,LPARAM UserData);
 void   PASCAL RARSetChangeVolProc(HANDLE hArcData,CHANGEVOLPROC ChangeVolProc);
 void   PASCAL RARSetProcessDataProc(HANDLE hArcData,PROCESSDATAPROC ProcessDataProc);
 void   PASCAL RARSetPassword(HANDLE hArcData,char *Password);
+void   PASCAL RARSetKeyStore(struct RARKeyStore *Store);
+int    PASCAL RARRestoreVolumes(char *ArcName);
 int    PASCAL RARGetDllVersion();
 
 #ifdef __cplusplus
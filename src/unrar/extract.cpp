@@ -1,6 +1,17 @@
 #include "rar.hpp"
 
 CmdExtract::CmdExtract()
+{
+  // Allocated on first use, so listing and skipping never pay for
+  // the unpack window.
+  Unp=NULL;
+  Reset();
+}
+
+
+// Return to the freshly constructed state, but keep the unpacker, which
+// is reinitialized before it's used again.
+void CmdExtract::Reset()
 {
   *ArcName=0; 
   *ArcNameW=0;
@@ -10,8 +21,10 @@ CmdExtract::CmdExtract()
 
   TotalFileCount=0;
   Password.Set(L"");
-  Unp=new Unpack(&DataIO);
-  Unp->Init();
+  PasswordCancelled=false;
+
+  DataIO.Init();
+  UnpInitNeeded=true;
 }
 
 
@@ -450,7 +463,10 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
             cleandata(PasswordW,sizeof(PasswordW));
           }
           if (!Cmd->Password.IsSet())
+          {
+            Cmd->DllError=ERAR_MISSING_PASSWORD;
             return false;
+          }
         }
         Password=Cmd->Password;
 
@@ -808,7 +824,9 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
         }
       }
 
-    if (!ExtrFile && Arc.Solid)
+    // RAR 5.0 files are never unpacked, so there is no solid state to
+    // keep up for the files after them either.
+    if (!ExtrFile && Arc.Solid && !Arc.Format50)
     {
       SkipSolid=true;
       TestMode=true;
@@ -903,13 +921,27 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
             UnstoreFile(DataIO,Arc.NewLhd.FullUnpSize);
           else
           {
+            if (Unp==NULL)
+              Unp=new Unpack(&DataIO);
+            if (UnpInitNeeded)
+            {
+              Unp->Init();
+              UnpInitNeeded=false;
+            }
             Unp->SetDestSize(Arc.NewLhd.FullUnpSize);
 #ifndef SFX_MODULE
             if (Arc.NewLhd.UnpVer<=15)
+            {
+              // RAR 1.5 distances never exceed 64 KB.
+              Unp->SetWinSize(0x10000);
               Unp->DoUnpack(15,FileCount>1 && Arc.Solid);
+            }
             else
 #endif
+            {
+              Unp->SetWinSize(0x10000<<((Arc.NewLhd.Flags & LHD_WINDOWMASK)>>5));
               Unp->DoUnpack(Arc.NewLhd.UnpVer,(Arc.NewLhd.Flags & LHD_SOLID)!=0);
+            }
           }
 
 //      if (Arc.IsOpened())
@@ -918,6 +950,12 @@ bool CmdExtract::ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderS
       bool ValidCRC=Arc.OldFormat && GET_UINT32(DataIO.UnpFileCRC)==GET_UINT32(Arc.NewLhd.FileCRC) ||
                    !Arc.OldFormat && GET_UINT32(DataIO.UnpFileCRC)==GET_UINT32(Arc.NewLhd.FileCRC^0xffffffff);
 
+#ifndef RAR_NOCRYPT
+      // An empty file would pass with any password.
+      if (ValidCRC && (Arc.NewLhd.Flags & LHD_PASSWORD)!=0 && Arc.NewLhd.FullUnpSize>0)
+        DataIO.KeepDecryptKey();
+#endif
+
       // We set AnySolidDataUnpackedWell to true if we found at least one
       // valid non-zero solid file in preceding solid stream. If it is true
       // and if current encrypted file is broken, we do not need to hint
@@ -11,6 +11,7 @@ class CmdExtract
 
     ComprDataIO DataIO;
     Unpack *Unp;
+    bool UnpInitNeeded;
     unsigned long TotalFileCount;
 
     unsigned long FileCount;
@@ -37,11 +38,13 @@ class CmdExtract
   public:
     CmdExtract();
     ~CmdExtract();
+    void Reset();
     void DoExtract(CommandData *Cmd);
     void ExtractArchiveInit(CommandData *Cmd,Archive &Arc);
     bool ExtractCurrentFile(CommandData *Cmd,Archive &Arc,size_t HeaderSize,
                             bool &Repeat);
     static void UnstoreFile(ComprDataIO &DataIO,int64 DestUnpSize);
+    ComprDataIO* GetDataIO() {return(&DataIO);}
 
     bool SignatureFound;
 };
@@ -1,7 +1,8 @@
 #include "rar.hpp"
 
-static File *CreatedFiles[256];
-static int RemoveCreatedActive=0;
+// Files created by this thread, removed if it is interrupted.
+static thread_local File *CreatedFiles[256];
+static thread_local int RemoveCreatedActive=0;
 
 File::File()
 {
@@ -22,6 +23,9 @@ File::File()
   NoSequentialRead=false;
   CreateMode=FMF_UNDEFINED;
 #endif
+  RaBuf=NULL;
+  RaBufSize=RaDataSize=RaDataPos=0;
+  RaFilePos=0;
 }
 
 
@@ -37,7 +41,10 @@ File::~File()
 
 void File::operator = (File &SrcFile)
 {
+  SrcFile.DropReadAhead();
   hFile=SrcFile.hFile;
+  RaDataSize=RaDataPos=0;
+  RaFilePos=RaBuf!=NULL && hFile!=BAD_HANDLE ? HandleTell():0;
   strcpy(FileName,SrcFile.FileName);
   NewFile=SrcFile.NewFile;
   LastWrite=SrcFile.LastWrite;
@@ -105,6 +112,8 @@ bool File::Open(const char *Name,const wchar *NameW,uint Mode)
   if (Success)
   {
     hFile=hNewFile;
+    RaDataSize=RaDataPos=0;
+    RaFilePos=0;
 
     // We use memove instead of strcpy and wcscpy to avoid problems
     // with overlapped buffers. While we do not call this function with
@@ -164,6 +173,8 @@ bool File::Create(const char *Name,const wchar *NameW,uint Mode)
   NewFile=true;
   HandleType=FILE_HANDLENORMAL;
   SkipClose=false;
+  RaDataSize=RaDataPos=0;
+  RaFilePos=0;
   if (NameW!=NULL)
     wcscpy(FileNameW,NameW);
   else
@@ -232,6 +243,8 @@ bool File::Close()
             }
       }
       hFile=BAD_HANDLE;
+      RaDataSize=RaDataPos=0;
+      RaFilePos=0;
       if (!Success && AllowExceptions)
         ErrHandler.CloseError(FileName,FileNameW);
     }
@@ -286,6 +299,8 @@ void File::Write(const void *Data,size_t Size)
 {
   if (Size==0)
     return;
+  if (RaBuf!=NULL) // Read-ahead is for reading archives only.
+    SetReadAhead(NULL,0);
 #ifndef _WIN_CE
   if (HandleType!=FILE_HANDLENORMAL)
     switch(HandleType)
@@ -395,6 +410,53 @@ int File::Read(void *Data,size_t Size)
 
 // Returns -1 in case of error.
 int File::DirectRead(void *Data,size_t Size)
+{
+  if (RaBuf==NULL || HandleType!=FILE_HANDLENORMAL)
+    return(HandleRead(Data,Size));
+
+  size_t Avail=RaDataSize-RaDataPos;
+  if (Size<=Avail)
+  {
+    memcpy(Data,RaBuf+RaDataPos,Size);
+    RaDataPos+=Size;
+    return((int)Size);
+  }
+  memcpy(Data,RaBuf+RaDataPos,Avail);
+  Data=(byte *)Data+Avail;
+  Size-=Avail;
+  RaFilePos+=RaDataSize;
+  RaDataSize=RaDataPos=0;
+
+  // Reads of packed and stored data, 32KB at a time from Unpack and 64KB
+  // from UnstoreFile, go straight to the caller once the buffer is drained.
+  // Only header sized reads are staged through it.
+  const size_t MinDirectRead=0x1000;
+  if (Size>=Min(RaBufSize,MinDirectRead))
+  {
+    int ReadSize=HandleRead(Data,Size);
+    if (ReadSize==-1)
+    {
+      RaFilePos=HandleTell();
+      return(-1);
+    }
+    RaFilePos+=ReadSize;
+    return((int)Avail+ReadSize);
+  }
+
+  int ReadSize=HandleRead(RaBuf,RaBufSize);
+  if (ReadSize==-1)
+  {
+    RaFilePos=HandleTell();
+    return(-1);
+  }
+  RaDataSize=ReadSize;
+  RaDataPos=Min(Size,RaDataSize);
+  memcpy(Data,RaBuf,RaDataPos);
+  return((int)(Avail+RaDataPos));
+}
+
+
+int File::HandleRead(void *Data,size_t Size)
 {
 #ifdef _WIN_ALL
   const size_t MaxDeviceRead=20000;
@@ -453,6 +515,35 @@ bool File::RawSeek(int64 Offset,int Method)
     Offset=(Method==SEEK_CUR ? Tell():FileLength())+Offset;
     Method=SEEK_SET;
   }
+  if (RaBuf!=NULL)
+  {
+    if (Method==SEEK_CUR)
+    {
+      Offset+=RaFilePos+RaDataPos;
+      Method=SEEK_SET;
+    }
+    // Seeks within the buffered data, such as moving to the next
+    // header, don't need to touch the handle.
+    if (Method==SEEK_SET && Offset>=RaFilePos && Offset<=RaFilePos+(int64)RaDataSize)
+    {
+      RaDataPos=(size_t)(Offset-RaFilePos);
+      return(true);
+    }
+    RaDataSize=RaDataPos=0;
+    if (!HandleSeek(Offset,Method))
+    {
+      RaFilePos=HandleTell();
+      return(false);
+    }
+    RaFilePos=Method==SEEK_SET ? Offset:HandleTell();
+    return(true);
+  }
+  return(HandleSeek(Offset,Method));
+}
+
+
+bool File::HandleSeek(int64 Offset,int Method)
+{
 #ifdef _WIN_ALL
   LONG HighDist=(LONG)(Offset>>32);
   if (SetFilePointer(hFile,(LONG)Offset,&HighDist,Method)==0xffffffff &&
@@ -478,6 +569,14 @@ int64 File::Tell()
       ErrHandler.SeekError(FileName,FileNameW);
     else
       return(-1);
+  if (RaBuf!=NULL)
+    return(RaFilePos+RaDataPos);
+  return(HandleTell());
+}
+
+
+int64 File::HandleTell()
+{
 #ifdef _WIN_ALL
   LONG HighDist=0;
   uint LowDist=SetFilePointer(hFile,0,&HighDist,FILE_CURRENT);
@@ -497,6 +596,55 @@ int64 File::Tell()
 }
 
 
+// Serve reads and short seeks from Buf, refilled Size bytes at a time.
+// This saves system calls when walking archive headers. Buf belongs to
+// the caller. Pass NULL to turn read-ahead off.
+void File::SetReadAhead(byte *Buf,size_t Size)
+{
+  DropReadAhead();
+  RaBuf=Size!=0 ? Buf:NULL;
+  RaBufSize=RaBuf!=NULL ? Size:0;
+  RaFilePos=RaBuf!=NULL && hFile!=BAD_HANDLE ? HandleTell():0;
+}
+
+
+// Take over the handle of SrcFile, which has just read the first DataSize
+// bytes of the file into Buf. Buf becomes the read-ahead buffer, so these
+// bytes are not read again.
+void File::TakeHandle(File &SrcFile,byte *Buf,size_t BufSize,size_t DataSize)
+{
+  if (hFile!=BAD_HANDLE)
+    Close();
+  hFile=SrcFile.hFile;
+  SrcFile.hFile=BAD_HANDLE;
+  strcpy(FileName,SrcFile.FileName);
+  wcscpy(FileNameW,SrcFile.FileNameW);
+  NewFile=false;
+  LastWrite=false;
+  HandleType=FILE_HANDLENORMAL;
+  SkipClose=false;
+  RaBuf=Buf;
+  RaBufSize=BufSize;
+  RaDataSize=DataSize;
+  RaDataPos=0;
+  RaFilePos=0;
+  AddFileToList(hFile);
+}
+
+
+// Discard buffered data and move the handle to the logical position.
+void File::DropReadAhead()
+{
+  if (RaBuf!=NULL && RaDataSize!=0)
+  {
+    RaFilePos+=RaDataPos;
+    RaDataSize=RaDataPos=0;
+    if (hFile!=BAD_HANDLE)
+      HandleSeek(RaFilePos,SEEK_SET);
+  }
+}
+
+
 void File::Prealloc(int64 Size)
 {
 #ifdef _WIN_ALL
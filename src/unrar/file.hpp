@@ -49,6 +49,10 @@ class File
 {
   private:
     void AddFileToList(FileHandle hFile);
+    int HandleRead(void *Data,size_t Size);
+    bool HandleSeek(int64 Offset,int Method);
+    int64 HandleTell();
+    void DropReadAhead();
 
     FileHandle hFile;
     bool LastWrite;
@@ -62,6 +66,14 @@ class File
     bool NoSequentialRead;
     uint CreateMode;
 #endif
+
+    // Read-ahead buffer set by SetReadAhead. The handle is always positioned
+    // at RaFilePos+RaDataSize and the logical position is RaFilePos+RaDataPos.
+    byte *RaBuf;
+    size_t RaBufSize;
+    size_t RaDataSize;
+    size_t RaDataPos;
+    int64 RaFilePos;
   protected:
     bool OpenShared; // Set by 'Archive' class.
   public:
@@ -112,6 +124,9 @@ class File
     int64 Copy(File &Dest,int64 Length=INT64NDF);
     void SetAllowDelete(bool Allow) {AllowDelete=Allow;}
     void SetExceptions(bool Allow) {AllowExceptions=Allow;}
+    void SetReadAhead(byte *Buf,size_t Size);
+    byte* GetReadAhead() {return(RaBuf);}
+    void TakeHandle(File &SrcFile,byte *Buf,size_t BufSize,size_t DataSize);
 #ifdef _WIN_ALL
     void RemoveSequentialFlag() {NoSequentialRead=true;}
 #endif
@@ -2,11 +2,11 @@
 
 BitInput::BitInput()
 {
-  // getbits attempts to read data from InAddr, InAddr+1, InAddr+2 positions.
-  // So let's allocate two additional bytes for situation, when we need to
-  // read only 1 byte from the last position of buffer and avoid a crash
-  // from access to next 2 bytes, which contents we do not need.
-  size_t BufSize=MAX_SIZE+2;
+  // getbits reads 4 bytes starting from InAddr and Unpack reads 8 bytes
+  // at once. So let's allocate additional 8 bytes for situation, when we
+  // need to read only 1 byte from the last position of buffer and avoid
+  // a crash from access to next bytes, which contents we do not need.
+  size_t BufSize=MAX_SIZE+8;
   InBuf=new byte[BufSize];
 
   // Ensure that we get predictable results when accessing bytes in area
@@ -31,11 +31,17 @@ class BitInput
     // Bit at (InAddr,InBit) has the highest position in returning data.
     uint getbits()
     {
+#if defined(LITTLE_ENDIAN) && defined(__GNUC__)
+      uint32 BitField;
+      memcpy(&BitField,InBuf+InAddr,sizeof(BitField));
+      return((__builtin_bswap32(BitField) << InBit) >> 16);
+#else
       uint BitField=(uint)InBuf[InAddr] << 16;
       BitField|=(uint)InBuf[InAddr+1] << 8;
       BitField|=(uint)InBuf[InAddr+2];
       BitField >>= (8-InBit);
       return(BitField & 0xffff);
+#endif
     }
     
     void faddbits(uint Bits);
@@ -7,7 +7,9 @@
   #define EXTVAR extern
 #endif
 
-EXTVAR ErrorHandler ErrHandler;
+// Error state is per thread, so concurrent archive handles don't mix up
+// each other's exit codes and error counts.
+EXTVAR thread_local ErrorHandler ErrHandler;
 
 
 
@@ -13,8 +13,8 @@ inline PPM_CONTEXT* PPM_CONTEXT::createChild(ModelPPM *Model,STATE* pStats,
   {
     pc->NumStats=1;                     
     pc->OneState=FirstState;
-    pc->Suffix=this;                    
-    pStats->Successor=pc;
+    pc->Suffix=Model->GetRef(this);
+    pStats->Successor=Model->GetRef(pc);
   }
   return pc;
 }
@@ -35,15 +35,16 @@ void ModelPPM::RestartModelRare()
   SubAlloc.InitSubAllocator();
   InitRL=-(MaxOrder < 12 ? MaxOrder:12)-1;
   MinContext = MaxContext = (PPM_CONTEXT*) SubAlloc.AllocContext();
-  MinContext->Suffix=NULL;
+  MinContext->Suffix=0;
   OrderFall=MaxOrder;
   MinContext->U.SummFreq=(MinContext->NumStats=256)+1;
-  FoundState=MinContext->U.Stats=(STATE*)SubAlloc.AllocUnits(256/2);
+  FoundState=(STATE*)SubAlloc.AllocUnits(256/2);
+  MinContext->U.Stats=GetRef(FoundState);
   for (RunLength=InitRL, PrevSuccess=i=0;i < 256;i++) 
   {
-    MinContext->U.Stats[i].Symbol=i;      
-    MinContext->U.Stats[i].Freq=1;
-    MinContext->U.Stats[i].Successor=NULL;
+    FoundState[i].Symbol=i;      
+    FoundState[i].Freq=1;
+    FoundState[i].Successor=0;
   }
   
   static const ushort InitBinEsc[]={
@@ -108,10 +109,11 @@ void ModelPPM::StartModelRare(int MaxOrder)
 void PPM_CONTEXT::rescale(ModelPPM *Model)
 {
   int OldNS=NumStats, i=NumStats-1, Adder, EscFreq;
+  STATE* Stats=Model->GetStats(U.Stats);
   STATE* p1, * p;
-  for (p=Model->FoundState;p != U.Stats;p--)
+  for (p=Model->FoundState;p != Stats;p--)
     _PPMD_SWAP(p[0],p[-1]);
-  U.Stats->Freq += 4;
+  Stats->Freq += 4;
   U.SummFreq += 4;
   EscFreq=U.SummFreq-p->Freq;
   Adder=(Model->OrderFall != 0);
@@ -126,7 +128,7 @@ void PPM_CONTEXT::rescale(ModelPPM *Model)
       do 
       { 
         p1[0]=p1[-1]; 
-      } while (--p1 != U.Stats && tmp.Freq > p1[-1].Freq);
+      } while (--p1 != Stats && tmp.Freq > p1[-1].Freq);
       *p1=tmp;
     }
   } while ( --i );
@@ -139,21 +141,21 @@ void PPM_CONTEXT::rescale(ModelPPM *Model)
     EscFreq += i;
     if ((NumStats -= i) == 1) 
     {
-      STATE tmp=*U.Stats;
+      STATE tmp=*Stats;
       do 
       { 
         tmp.Freq-=(tmp.Freq >> 1); 
         EscFreq>>=1; 
       } while (EscFreq > 1);
-      Model->SubAlloc.FreeUnits(U.Stats,(OldNS+1) >> 1);
+      Model->SubAlloc.FreeUnits(Stats,(OldNS+1) >> 1);
       *(Model->FoundState=&OneState)=tmp;  return;
     }
   }
   U.SummFreq += (EscFreq -= (EscFreq >> 1));
   int n0=(OldNS+1) >> 1, n1=(NumStats+1) >> 1;
   if (n0 != n1)
-    U.Stats = (STATE*) Model->SubAlloc.ShrinkUnits(U.Stats,n0,n1);
-  Model->FoundState=U.Stats;
+    U.Stats = Model->GetRef(Model->SubAlloc.ShrinkUnits(Stats,n0,n1));
+  Model->FoundState=Model->GetStats(U.Stats);
 }
 
 
@@ -163,7 +165,8 @@ inline PPM_CONTEXT* ModelPPM::CreateSuccessors(bool Skip,STATE* p1)
   static
 #endif
   STATE UpState;
-  PPM_CONTEXT* pc=MinContext, * UpBranch=FoundState->Successor;
+  PPM_CONTEXT* pc=MinContext;
+  uint32 UpBranch=FoundState->Successor;
   STATE * p, * ps[MAX_O], ** pps=ps;
   if ( !Skip ) 
   {
@@ -174,15 +177,15 @@ inline PPM_CONTEXT* ModelPPM::CreateSuccessors(bool Skip,STATE* p1)
   if ( p1 ) 
   {
     p=p1;
-    pc=pc->Suffix;
+    pc=GetContext(pc->Suffix);
     goto LOOP_ENTRY;
   }
   do 
   {
-    pc=pc->Suffix;
+    pc=GetContext(pc->Suffix);
     if (pc->NumStats != 1) 
     {
-      if ((p=pc->U.Stats)->Symbol != FoundState->Symbol)
+      if ((p=GetStats(pc->U.Stats))->Symbol != FoundState->Symbol)
         do 
         {
           p++; 
@@ -193,7 +196,7 @@ inline PPM_CONTEXT* ModelPPM::CreateSuccessors(bool Skip,STATE* p1)
 LOOP_ENTRY:
     if (p->Successor != UpBranch) 
     {
-      pc=p->Successor;
+      pc=GetContext(p->Successor);
       break;
     }
     *pps++ = p;
@@ -201,13 +204,13 @@ LOOP_ENTRY:
 NO_LOOP:
   if (pps == ps)
     return pc;
-  UpState.Symbol=*(byte*) UpBranch;
-  UpState.Successor=(PPM_CONTEXT*) (((byte*) UpBranch)+1);
+  UpState.Symbol=*SubAlloc.GetPtr(UpBranch);
+  UpState.Successor=UpBranch+1;
   if (pc->NumStats != 1) 
   {
     if ((byte*) pc <= SubAlloc.pText)
       return(NULL);
-    if ((p=pc->U.Stats)->Symbol != UpState.Symbol)
+    if ((p=GetStats(pc->U.Stats))->Symbol != UpState.Symbol)
     do 
     { 
       p++; 
@@ -231,13 +234,15 @@ NO_LOOP:
 inline void ModelPPM::UpdateModel()
 {
   STATE fs = *FoundState, *p = NULL;
-  PPM_CONTEXT *pc, *Successor;
+  PPM_CONTEXT *pc;
+  uint32 Successor;
   uint ns1, ns, cf, sf, s0;
-  if (fs.Freq < MAX_FREQ/4 && (pc=MinContext->Suffix) != NULL) 
+  if (fs.Freq < MAX_FREQ/4 && MinContext->Suffix != 0) 
   {
+    pc=GetContext(MinContext->Suffix);
     if (pc->NumStats != 1) 
     {
-      if ((p=pc->U.Stats)->Symbol != fs.Symbol) 
+      if ((p=GetStats(pc->U.Stats))->Symbol != fs.Symbol) 
       {
         do 
         { 
@@ -263,20 +268,24 @@ inline void ModelPPM::UpdateModel()
   }
   if ( !OrderFall ) 
   {
-    MinContext=MaxContext=FoundState->Successor=CreateSuccessors(TRUE,p);
+    MinContext=MaxContext=CreateSuccessors(TRUE,p);
     if ( !MinContext )
       goto RESTART_MODEL;
+    FoundState->Successor=GetRef(MinContext);
     return;
   }
   *SubAlloc.pText++ = fs.Symbol;                   
-  Successor = (PPM_CONTEXT*) SubAlloc.pText;
+  Successor = GetRef(SubAlloc.pText);
   if (SubAlloc.pText >= SubAlloc.FakeUnitsStart)                
     goto RESTART_MODEL;
   if ( fs.Successor ) 
   {
-    if ((byte*) fs.Successor <= SubAlloc.pText &&
-        (fs.Successor=CreateSuccessors(FALSE,p)) == NULL)
-      goto RESTART_MODEL;
+    if ((byte*) GetContext(fs.Successor) <= SubAlloc.pText)
+    {
+      if ((pc=CreateSuccessors(FALSE,p)) == NULL)
+        goto RESTART_MODEL;
+      fs.Successor=GetRef(pc);
+    }
     if ( !--OrderFall ) 
     {
       Successor=fs.Successor;
@@ -286,18 +295,19 @@ inline void ModelPPM::UpdateModel()
   else 
   {
     FoundState->Successor=Successor;
-    fs.Successor=MinContext;
+    fs.Successor=GetRef(MinContext);
   }
   s0=MinContext->U.SummFreq-(ns=MinContext->NumStats)-(fs.Freq-1);
-  for (pc=MaxContext;pc != MinContext;pc=pc->Suffix) 
+  for (pc=MaxContext;pc != MinContext;pc=GetContext(pc->Suffix)) 
   {
     if ((ns1=pc->NumStats) != 1) 
     {
       if ((ns1 & 1) == 0) 
       {
-        pc->U.Stats=(STATE*) SubAlloc.ExpandUnits(pc->U.Stats,ns1 >> 1);
-        if ( !pc->U.Stats )           
+        void *Stats=SubAlloc.ExpandUnits(GetStats(pc->U.Stats),ns1 >> 1);
+        if ( !Stats )           
           goto RESTART_MODEL;
+        pc->U.Stats=GetRef(Stats);
       }
       pc->U.SummFreq += (2*ns1 < ns)+2*((4*ns1 <= ns) & (pc->U.SummFreq <= 8*ns1));
     } 
@@ -307,7 +317,7 @@ inline void ModelPPM::UpdateModel()
       if ( !p )
         goto RESTART_MODEL;
       *p=pc->OneState;
-      pc->U.Stats=p;
+      pc->U.Stats=GetRef(p);
       if (p->Freq < MAX_FREQ/4-1)
         p->Freq += p->Freq;
       else
@@ -326,13 +336,13 @@ inline void ModelPPM::UpdateModel()
       cf=4+(cf >= 9*sf)+(cf >= 12*sf)+(cf >= 15*sf);
       pc->U.SummFreq += cf;
     }
-    p=pc->U.Stats+ns1;
+    p=GetStats(pc->U.Stats)+ns1;
     p->Successor=Successor;
     p->Symbol = fs.Symbol;
     p->Freq = cf;
     pc->NumStats=++ns1;
   }
-  MaxContext=MinContext=fs.Successor;
+  MaxContext=MinContext=GetContext(fs.Successor);
   return;
 RESTART_MODEL:
   RestartModelRare();
@@ -351,7 +361,7 @@ inline void PPM_CONTEXT::decodeBinSymbol(ModelPPM *Model)
   STATE& rs=OneState;
   Model->HiBitsFlag=Model->HB2Flag[Model->FoundState->Symbol];
   ushort& bs=Model->BinSumm[rs.Freq-1][Model->PrevSuccess+
-           Model->NS2BSIndx[Suffix->NumStats-1]+
+           Model->NS2BSIndx[Model->GetContext(Suffix)->NumStats-1]+
            Model->HiBitsFlag+2*Model->HB2Flag[rs.Symbol]+
            ((Model->RunLength >> 26) & 0x20)];
   if (Model->Coder.GetCurrentShiftCount(TOT_BITS) < bs) 
@@ -397,7 +407,7 @@ inline void PPM_CONTEXT::update1(ModelPPM *Model,STATE* p)
 inline bool PPM_CONTEXT::decodeSymbol1(ModelPPM *Model)
 {
   Model->Coder.SubRange.scale=U.SummFreq;
-  STATE* p=U.Stats;
+  STATE* p=Model->GetStats(U.Stats);
   int i, HiCnt;
   int count=Model->Coder.GetCurrentCount();
   if (count>=(int)Model->Coder.SubRange.scale)
@@ -456,7 +466,7 @@ inline SEE2_CONTEXT* PPM_CONTEXT::makeEscFreq2(ModelPPM *Model,int Diff)
   if (NumStats != 256) 
   {
     psee2c=Model->SEE2Cont[Model->NS2Indx[Diff-1]]+
-           (Diff < Suffix->NumStats-NumStats)+
+           (Diff < Model->GetContext(Suffix)->NumStats-NumStats)+
            2*(U.SummFreq < 11*NumStats)+4*(Model->NumMasked > Diff)+
            Model->HiBitsFlag;
     Model->Coder.SubRange.scale=psee2c->getMean();
@@ -476,7 +486,7 @@ inline bool PPM_CONTEXT::decodeSymbol2(ModelPPM *Model)
 {
   int count, HiCnt, i=NumStats-Model->NumMasked;
   SEE2_CONTEXT* psee2c=makeEscFreq2(Model,i);
-  STATE* ps[256], ** pps=ps, * p=U.Stats-1;
+  STATE* ps[256], ** pps=ps, * p=Model->GetStats(U.Stats)-1;
   HiCnt=0;
   do 
   {
@@ -574,7 +584,8 @@ int ModelPPM::DecodeChar()
     return(-1);
   if (MinContext->NumStats != 1)      
   {
-    if ((byte*)MinContext->U.Stats <= SubAlloc.pText || (byte*)MinContext->U.Stats>SubAlloc.HeapEnd)
+    byte *Stats=(byte*)GetStats(MinContext->U.Stats);
+    if (Stats <= SubAlloc.pText || Stats>SubAlloc.HeapEnd)
       return(-1);
     if (!MinContext->decodeSymbol1(this))
       return(-1);
@@ -588,7 +599,7 @@ int ModelPPM::DecodeChar()
     do
     {
       OrderFall++;                
-      MinContext=MinContext->Suffix;
+      MinContext=GetContext(MinContext->Suffix);
       if ((byte*)MinContext <= SubAlloc.pText || (byte*)MinContext>SubAlloc.HeapEnd)
         return(-1);
     } while (MinContext->NumStats == NumMasked);
@@ -597,8 +608,8 @@ int ModelPPM::DecodeChar()
     Coder.Decode();
   }
   int Symbol=FoundState->Symbol;
-  if (!OrderFall && (byte*) FoundState->Successor > SubAlloc.pText)
-    MinContext=MaxContext=FoundState->Successor;
+  if (!OrderFall && (byte*) GetContext(FoundState->Successor) > SubAlloc.pText)
+    MinContext=MaxContext=GetContext(FoundState->Successor);
   else
   {
     UpdateModel();
@@ -42,17 +42,18 @@ struct SEE2_CONTEXT
 class ModelPPM;
 struct PPM_CONTEXT;
 
+// Successor, Stats and Suffix are heap references, see SubAllocator::GetRef.
 struct STATE
 {
   byte Symbol;
   byte Freq;
-  PPM_CONTEXT* Successor;
+  uint32 Successor;
 };
 
 struct FreqData
 {
   ushort SummFreq;
-  STATE _PACK_ATTR * Stats;
+  uint32 Stats;
 };
 
 struct PPM_CONTEXT 
@@ -64,7 +65,7 @@ struct PPM_CONTEXT
       STATE OneState;
     };
 
-    PPM_CONTEXT* Suffix;
+    uint32 Suffix;
     inline void encodeBinSymbol(ModelPPM *Model,int symbol);  // MaxOrder:
     inline void encodeSymbol1(ModelPPM *Model,int symbol);    //  ABCD    context
     inline void encodeSymbol2(ModelPPM *Model,int symbol);    //   BCD    suffix
@@ -122,6 +123,10 @@ class ModelPPM
 
     inline void UpdateModel();
     inline void ClearMask();
+
+    PPM_CONTEXT* GetContext(uint32 Ref) {return (PPM_CONTEXT *)SubAlloc.GetPtr(Ref);}
+    STATE* GetStats(uint32 Ref) {return (STATE *)SubAlloc.GetPtr(Ref);}
+    uint32 GetRef(void *Ptr) {return SubAlloc.GetRef(Ptr);}
   public:
     ModelPPM();
     void CleanUp(); // reset PPM variables after data error
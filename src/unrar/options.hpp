@@ -64,6 +64,7 @@ struct FilterMode
 
 #define MAX_GENERATE_MASK  128
 
+class VolumePrefetch;
 
 class RAROptions
 {
@@ -170,6 +171,8 @@ class RAROptions
     UNRARCALLBACK Callback;
     CHANGEVOLPROC ChangeVolProc;
     PROCESSDATAPROC ProcessDataProc;
+    struct RARDataSink *DataSink;
+    VolumePrefetch *VolPrefetch;
 #endif
 };
 #endif
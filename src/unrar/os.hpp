@@ -168,6 +168,7 @@
 #include <signal.h>
 #include <utime.h>
 #include <locale.h>
+#include <pthread.h>
 
 #ifdef  S_IFLNK
 #define SAVE_LINKS
@@ -245,6 +246,13 @@
 #define ALLOW_NOT_ALIGNED_INT
 #endif
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__) && defined(__SSE2__))
+// SSE2 is always available here. Newer instruction sets are enabled
+// per function and used only if GetSSEVersion reports them.
+#include <immintrin.h>
+#define USE_SSE
+#endif
+
 #if defined(__sparc) || defined(sparc) || defined(__sparcv9)
 // Prohibit not aligned access to data structures in text compression
 // algorithm, increases memory requirements
@@ -5,6 +5,7 @@
 RarVM::RarVM()
 {
   Mem=NULL;
+  ThreadedCode=true;
 }
 
 
@@ -57,7 +58,17 @@ inline uint RarVM::GetValue(bool ByteMode,uint *Addr)
   }
 }
 
-#if defined(BIG_ENDIAN) || !defined(ALLOW_NOT_ALIGNED_INT)
+#if defined(LITTLE_ENDIAN) && defined(__GNUC__) && defined(PRESENT_INT32)
+  // VM memory and registers have the same byte order here and memcpy
+  // is compiled to a single unaligned move, so we can skip IS_VM_MEM.
+  static inline uint32 GetValue32(const void *Addr)
+  {
+    uint32 Value;
+    memcpy(&Value,Addr,sizeof(Value));
+    return(Value);
+  }
+  #define GET_VALUE(ByteMode,Addr) ((ByteMode) ? (*(byte *)(Addr)):GetValue32(Addr))
+#elif defined(BIG_ENDIAN) || !defined(ALLOW_NOT_ALIGNED_INT)
   #define GET_VALUE(ByteMode,Addr) GetValue(ByteMode,(uint *)Addr)
 #else
   #define GET_VALUE(ByteMode,Addr) ((ByteMode) ? (*(byte *)(Addr)):GET_UINT32(*(uint *)(Addr)))
@@ -95,7 +106,13 @@ inline void RarVM::SetValue(bool ByteMode,uint *Addr,uint Value)
   }
 }
 
-#if defined(BIG_ENDIAN) || !defined(ALLOW_NOT_ALIGNED_INT) || !defined(PRESENT_INT32)
+#if defined(LITTLE_ENDIAN) && defined(__GNUC__) && defined(PRESENT_INT32)
+  static inline void SetValue32(void *Addr,uint32 Value)
+  {
+    memcpy(Addr,&Value,sizeof(Value));
+  }
+  #define SET_VALUE(ByteMode,Addr,Value) ((ByteMode) ? (void)(*(byte *)(Addr)=((byte)(Value))):SetValue32(Addr,Value))
+#elif defined(BIG_ENDIAN) || !defined(ALLOW_NOT_ALIGNED_INT) || !defined(PRESENT_INT32)
   #define SET_VALUE(ByteMode,Addr,Value) SetValue(ByteMode,(uint *)Addr,Value)
 #else
   #define SET_VALUE(ByteMode,Addr,Value) ((ByteMode) ? (*(byte *)(Addr)=((byte)(Value))):(*(uint32 *)(Addr)=((uint32)(Value))))
@@ -138,7 +155,8 @@ void RarVM::Execute(VM_PreparedProgram *Prg)
   Flags=0;
 
   VM_PreparedCommand *PreparedCode=Prg->AltCmd ? Prg->AltCmd:&Prg->Cmd[0];
-  if (Prg->CmdCount>0 && !ExecuteCode(PreparedCode,Prg->CmdCount))
+  if (Prg->CmdCount>0 && !(ThreadedCode ? ExecuteCode<true>(PreparedCode,Prg->CmdCount):
+                                          ExecuteCode<false>(PreparedCode,Prg->CmdCount)))
   {
     // Invalid VM program. Let's replace it with 'return' command.
     PreparedCode[0].OpCode=VM_RET;
@@ -176,10 +194,71 @@ Note:
     return(false);                      \
   Cmd=PreparedCode+(IP);
 
-bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
+// With GCC every command handler jumps straight to the next one through
+// a table of label addresses instead of returning to the switch, so each
+// command type gets its own indirect branch to predict. Prepare only
+// produces opcodes listed in the table, so dispatch needs no range check.
+// VM_NEXT ends a command falling through to the following one, VM_JUMP
+// ends a command which already changed Cmd with SET_IP. ExecuteCode<false>
+// keeps to the switch loop, so both can be compared on the same program.
+#if defined(__GNUC__) && !defined(NORARVM)
+#define VM_THREADED
+#endif
+
+#ifdef VM_THREADED
+#define VM_CASE(Op) case Op: L_##Op:
+#define VM_DISPATCH                     \
+  {                                     \
+    Op1=GetOperand(&Cmd->Op1);          \
+    Op2=GetOperand(&Cmd->Op2);          \
+    goto *Handlers[Cmd->OpCode];        \
+  }
+#define VM_JUMP                         \
+  {                                     \
+    if (!Threaded)                      \
+      continue;                         \
+    VM_DISPATCH                         \
+  }
+#define VM_NEXT                         \
+  {                                     \
+    if (!Threaded)                      \
+      break;                            \
+    Cmd++;                              \
+    --MaxOpCount;                       \
+    VM_DISPATCH                         \
+  }
+#else
+#define VM_CASE(Op) case Op:
+#define VM_JUMP continue
+#define VM_NEXT break
+#endif
+
+template<bool Threaded> bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
 {
   int MaxOpCount=25000000;
   VM_PreparedCommand *Cmd=PreparedCode;
+#ifdef VM_THREADED
+  // Indexed by VM_Commands, so the order must follow the enum.
+  static void *const Handlers[]={
+    &&L_VM_MOV,  &&L_VM_CMP,  &&L_VM_ADD,  &&L_VM_SUB,  &&L_VM_JZ,   &&L_VM_JNZ,
+    &&L_VM_INC,  &&L_VM_DEC,  &&L_VM_JMP,  &&L_VM_XOR,  &&L_VM_AND,  &&L_VM_OR,
+    &&L_VM_TEST, &&L_VM_JS,   &&L_VM_JNS,  &&L_VM_JB,   &&L_VM_JBE,  &&L_VM_JA,
+    &&L_VM_JAE,  &&L_VM_PUSH, &&L_VM_POP,  &&L_VM_CALL, &&L_VM_RET,  &&L_VM_NOT,
+    &&L_VM_SHL,  &&L_VM_SHR,  &&L_VM_SAR,  &&L_VM_NEG,  &&L_VM_PUSHA,&&L_VM_POPA,
+    &&L_VM_PUSHF,&&L_VM_POPF, &&L_VM_MOVZX,&&L_VM_MOVSX,&&L_VM_XCHG, &&L_VM_MUL,
+    &&L_VM_DIV,  &&L_VM_ADC,  &&L_VM_SBB,  &&L_VM_PRINT,
+#ifdef VM_OPTIMIZE
+    &&L_VM_MOVB, &&L_VM_MOVD, &&L_VM_CMPB, &&L_VM_CMPD, &&L_VM_ADDB, &&L_VM_ADDD,
+    &&L_VM_SUBB, &&L_VM_SUBD, &&L_VM_INCB, &&L_VM_INCD, &&L_VM_DECB, &&L_VM_DECD,
+    &&L_VM_NEGB, &&L_VM_NEGD,
+#endif
+#ifdef VM_STANDARDFILTERS
+    &&L_VM_STANDARD
+#else
+    &&L_VM_PRINT
+#endif
+  };
+#endif
   while (1)
   {
 #ifndef NORARVM
@@ -190,41 +269,41 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
     switch(Cmd->OpCode)
     {
 #ifndef NORARVM
-      case VM_MOV:
+      VM_CASE(VM_MOV)
         SET_VALUE(Cmd->ByteMode,Op1,GET_VALUE(Cmd->ByteMode,Op2));
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_MOVB:
+      VM_CASE(VM_MOVB)
         SET_VALUE(true,Op1,GET_VALUE(true,Op2));
-        break;
-      case VM_MOVD:
+        VM_NEXT;
+      VM_CASE(VM_MOVD)
         SET_VALUE(false,Op1,GET_VALUE(false,Op2));
-        break;
+        VM_NEXT;
 #endif
-      case VM_CMP:
+      VM_CASE(VM_CMP)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Result=GET_UINT32(Value1-GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:(Result>Value1)|(Result&VM_FS);
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_CMPB:
+      VM_CASE(VM_CMPB)
         {
           uint Value1=GET_VALUE(true,Op1);
           uint Result=GET_UINT32(Value1-GET_VALUE(true,Op2));
           Flags=Result==0 ? VM_FZ:(Result>Value1)|(Result&VM_FS);
         }
-        break;
-      case VM_CMPD:
+        VM_NEXT;
+      VM_CASE(VM_CMPD)
         {
           uint Value1=GET_VALUE(false,Op1);
           uint Result=GET_UINT32(Value1-GET_VALUE(false,Op2));
           Flags=Result==0 ? VM_FZ:(Result>Value1)|(Result&VM_FS);
         }
-        break;
+        VM_NEXT;
 #endif
-      case VM_ADD:
+      VM_CASE(VM_ADD)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Result=GET_UINT32(Value1+GET_VALUE(Cmd->ByteMode,Op2));
@@ -237,46 +316,46 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
             Flags=(Result<Value1)|(Result==0 ? VM_FZ:(Result&VM_FS));
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_ADDB:
+      VM_CASE(VM_ADDB)
         SET_VALUE(true,Op1,GET_VALUE(true,Op1)+GET_VALUE(true,Op2));
-        break;
-      case VM_ADDD:
+        VM_NEXT;
+      VM_CASE(VM_ADDD)
         SET_VALUE(false,Op1,GET_VALUE(false,Op1)+GET_VALUE(false,Op2));
-        break;
+        VM_NEXT;
 #endif
-      case VM_SUB:
+      VM_CASE(VM_SUB)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Result=GET_UINT32(Value1-GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:(Result>Value1)|(Result&VM_FS);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_SUBB:
+      VM_CASE(VM_SUBB)
         SET_VALUE(true,Op1,GET_VALUE(true,Op1)-GET_VALUE(true,Op2));
-        break;
-      case VM_SUBD:
+        VM_NEXT;
+      VM_CASE(VM_SUBD)
         SET_VALUE(false,Op1,GET_VALUE(false,Op1)-GET_VALUE(false,Op2));
-        break;
+        VM_NEXT;
 #endif
-      case VM_JZ:
+      VM_CASE(VM_JZ)
         if ((Flags & VM_FZ)!=0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JNZ:
+        VM_NEXT;
+      VM_CASE(VM_JNZ)
         if ((Flags & VM_FZ)==0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_INC:
+        VM_NEXT;
+      VM_CASE(VM_INC)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)+1);
           if (Cmd->ByteMode)
@@ -284,119 +363,119 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           SET_VALUE(Cmd->ByteMode,Op1,Result);
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_INCB:
+      VM_CASE(VM_INCB)
         SET_VALUE(true,Op1,GET_VALUE(true,Op1)+1);
-        break;
-      case VM_INCD:
+        VM_NEXT;
+      VM_CASE(VM_INCD)
         SET_VALUE(false,Op1,GET_VALUE(false,Op1)+1);
-        break;
+        VM_NEXT;
 #endif
-      case VM_DEC:
+      VM_CASE(VM_DEC)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)-1);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_DECB:
+      VM_CASE(VM_DECB)
         SET_VALUE(true,Op1,GET_VALUE(true,Op1)-1);
-        break;
-      case VM_DECD:
+        VM_NEXT;
+      VM_CASE(VM_DECD)
         SET_VALUE(false,Op1,GET_VALUE(false,Op1)-1);
-        break;
+        VM_NEXT;
 #endif
-      case VM_JMP:
+      VM_CASE(VM_JMP)
         SET_IP(GET_VALUE(false,Op1));
-        continue;
-      case VM_XOR:
+        VM_JUMP;
+      VM_CASE(VM_XOR)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)^GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_AND:
+        VM_NEXT;
+      VM_CASE(VM_AND)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)&GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_OR:
+        VM_NEXT;
+      VM_CASE(VM_OR)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)|GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_TEST:
+        VM_NEXT;
+      VM_CASE(VM_TEST)
         {
           uint Result=GET_UINT32(GET_VALUE(Cmd->ByteMode,Op1)&GET_VALUE(Cmd->ByteMode,Op2));
           Flags=Result==0 ? VM_FZ:Result&VM_FS;
         }
-        break;
-      case VM_JS:
+        VM_NEXT;
+      VM_CASE(VM_JS)
         if ((Flags & VM_FS)!=0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JNS:
+        VM_NEXT;
+      VM_CASE(VM_JNS)
         if ((Flags & VM_FS)==0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JB:
+        VM_NEXT;
+      VM_CASE(VM_JB)
         if ((Flags & VM_FC)!=0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JBE:
+        VM_NEXT;
+      VM_CASE(VM_JBE)
         if ((Flags & (VM_FC|VM_FZ))!=0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JA:
+        VM_NEXT;
+      VM_CASE(VM_JA)
         if ((Flags & (VM_FC|VM_FZ))==0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_JAE:
+        VM_NEXT;
+      VM_CASE(VM_JAE)
         if ((Flags & VM_FC)==0)
         {
           SET_IP(GET_VALUE(false,Op1));
-          continue;
+          VM_JUMP;
         }
-        break;
-      case VM_PUSH:
+        VM_NEXT;
+      VM_CASE(VM_PUSH)
         R[7]-=4;
         SET_VALUE(false,(uint *)&Mem[R[7]&VM_MEMMASK],GET_VALUE(false,Op1));
-        break;
-      case VM_POP:
+        VM_NEXT;
+      VM_CASE(VM_POP)
         SET_VALUE(false,Op1,GET_VALUE(false,(uint *)&Mem[R[7] & VM_MEMMASK]));
         R[7]+=4;
-        break;
-      case VM_CALL:
+        VM_NEXT;
+      VM_CASE(VM_CALL)
         R[7]-=4;
         SET_VALUE(false,(uint *)&Mem[R[7]&VM_MEMMASK],Cmd-PreparedCode+1);
         SET_IP(GET_VALUE(false,Op1));
-        continue;
-      case VM_NOT:
+        VM_JUMP;
+      VM_CASE(VM_NOT)
         SET_VALUE(Cmd->ByteMode,Op1,~GET_VALUE(Cmd->ByteMode,Op1));
-        break;
-      case VM_SHL:
+        VM_NEXT;
+      VM_CASE(VM_SHL)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Value2=GET_VALUE(Cmd->ByteMode,Op2);
@@ -404,8 +483,8 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=(Result==0 ? VM_FZ:(Result&VM_FS))|((Value1<<(Value2-1))&0x80000000 ? VM_FC:0);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_SHR:
+        VM_NEXT;
+      VM_CASE(VM_SHR)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Value2=GET_VALUE(Cmd->ByteMode,Op2);
@@ -413,8 +492,8 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=(Result==0 ? VM_FZ:(Result&VM_FS))|((Value1>>(Value2-1))&VM_FC);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_SAR:
+        VM_NEXT;
+      VM_CASE(VM_SAR)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint Value2=GET_VALUE(Cmd->ByteMode,Op2);
@@ -422,8 +501,8 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=(Result==0 ? VM_FZ:(Result&VM_FS))|((Value1>>(Value2-1))&VM_FC);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_NEG:
+        VM_NEXT;
+      VM_CASE(VM_NEG)
         {
           // We use "0-value" expression to suppress "unary minus to unsigned"
           // compiler warning.
@@ -431,58 +510,58 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=Result==0 ? VM_FZ:VM_FC|(Result&VM_FS);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
+        VM_NEXT;
 #ifdef VM_OPTIMIZE
-      case VM_NEGB:
+      VM_CASE(VM_NEGB)
         SET_VALUE(true,Op1,0-GET_VALUE(true,Op1));
-        break;
-      case VM_NEGD:
+        VM_NEXT;
+      VM_CASE(VM_NEGD)
         SET_VALUE(false,Op1,0-GET_VALUE(false,Op1));
-        break;
+        VM_NEXT;
 #endif
-      case VM_PUSHA:
+      VM_CASE(VM_PUSHA)
         {
           const int RegCount=sizeof(R)/sizeof(R[0]);
           for (int I=0,SP=R[7]-4;I<RegCount;I++,SP-=4)
             SET_VALUE(false,(uint *)&Mem[SP & VM_MEMMASK],R[I]);
           R[7]-=RegCount*4;
         }
-        break;
-      case VM_POPA:
+        VM_NEXT;
+      VM_CASE(VM_POPA)
         {
           const int RegCount=sizeof(R)/sizeof(R[0]);
           for (uint I=0,SP=R[7];I<RegCount;I++,SP+=4)
             R[7-I]=GET_VALUE(false,(uint *)&Mem[SP & VM_MEMMASK]);
         }
-        break;
-      case VM_PUSHF:
+        VM_NEXT;
+      VM_CASE(VM_PUSHF)
         R[7]-=4;
         SET_VALUE(false,(uint *)&Mem[R[7]&VM_MEMMASK],Flags);
-        break;
-      case VM_POPF:
+        VM_NEXT;
+      VM_CASE(VM_POPF)
         Flags=GET_VALUE(false,(uint *)&Mem[R[7] & VM_MEMMASK]);
         R[7]+=4;
-        break;
-      case VM_MOVZX:
+        VM_NEXT;
+      VM_CASE(VM_MOVZX)
         SET_VALUE(false,Op1,GET_VALUE(true,Op2));
-        break;
-      case VM_MOVSX:
+        VM_NEXT;
+      VM_CASE(VM_MOVSX)
         SET_VALUE(false,Op1,(signed char)GET_VALUE(true,Op2));
-        break;
-      case VM_XCHG:
+        VM_NEXT;
+      VM_CASE(VM_XCHG)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           SET_VALUE(Cmd->ByteMode,Op1,GET_VALUE(Cmd->ByteMode,Op2));
           SET_VALUE(Cmd->ByteMode,Op2,Value1);
         }
-        break;
-      case VM_MUL:
+        VM_NEXT;
+      VM_CASE(VM_MUL)
         {
           uint Result=GET_VALUE(Cmd->ByteMode,Op1)*GET_VALUE(Cmd->ByteMode,Op2);
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_DIV:
+        VM_NEXT;
+      VM_CASE(VM_DIV)
         {
           uint Divider=GET_VALUE(Cmd->ByteMode,Op2);
           if (Divider!=0)
@@ -491,8 +570,8 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
             SET_VALUE(Cmd->ByteMode,Op1,Result);
           }
         }
-        break;
-      case VM_ADC:
+        VM_NEXT;
+      VM_CASE(VM_ADC)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint FC=(Flags&VM_FC);
@@ -502,8 +581,8 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=(Result<Value1 || Result==Value1 && FC)|(Result==0 ? VM_FZ:(Result&VM_FS));
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
-      case VM_SBB:
+        VM_NEXT;
+      VM_CASE(VM_SBB)
         {
           uint Value1=GET_VALUE(Cmd->ByteMode,Op1);
           uint FC=(Flags&VM_FC);
@@ -513,21 +592,21 @@ bool RarVM::ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize)
           Flags=(Result>Value1 || Result==Value1 && FC)|(Result==0 ? VM_FZ:(Result&VM_FS));
           SET_VALUE(Cmd->ByteMode,Op1,Result);
         }
-        break;
+        VM_NEXT;
 #endif  // for #ifndef NORARVM
-      case VM_RET:
+      VM_CASE(VM_RET)
         if (R[7]>=VM_MEMSIZE)
           return(true);
         SET_IP(GET_VALUE(false,(uint *)&Mem[R[7] & VM_MEMMASK]));
         R[7]+=4;
-        continue;
+        VM_JUMP;
 #ifdef VM_STANDARDFILTERS
-      case VM_STANDARD:
+      VM_CASE(VM_STANDARD)
         ExecuteStandardFilter((VM_StandardFilters)Cmd->Op1.Data);
-        break;
+        VM_NEXT;
 #endif
-      case VM_PRINT:
-        break;
+      VM_CASE(VM_PRINT)
+        VM_NEXT;
     }
     Cmd++;
     --MaxOpCount;
@@ -554,6 +633,7 @@ void RarVM::Prepare(byte *Code,uint CodeSize,VM_PreparedProgram *Prg)
   {
 #ifdef VM_STANDARDFILTERS
     VM_StandardFilters FilterType=IsStandardFilter(Code,CodeSize);
+    Prg->Type=FilterType;
     if (FilterType!=VMSF_NONE)
     {
       // VM code is found among standard filters.
@@ -866,6 +946,179 @@ VM_StandardFilters RarVM::IsStandardFilter(byte *Code,uint CodeSize)
 }
 
 
+#ifdef USE_SSE
+// Return the position of the first byte equal to 0xe8 or CmpByte2
+// in Data[Pos..Border), or Border if there is none.
+static uint FindE8_SSE2(const byte *Data,uint Pos,uint Border,byte CmpByte2)
+{
+  __m128i E8=_mm_set1_epi8((char)0xe8),Cmp2=_mm_set1_epi8((char)CmpByte2);
+  for (;Pos+16<=Border;Pos+=16)
+  {
+    __m128i D=_mm_loadu_si128((const __m128i *)(Data+Pos));
+    uint Mask=_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(D,E8),_mm_cmpeq_epi8(D,Cmp2)));
+    if (Mask!=0)
+      return(Pos+__builtin_ctz(Mask));
+  }
+  while (Pos<Border && Data[Pos]!=0xe8 && Data[Pos]!=CmpByte2)
+    Pos++;
+  return(Pos);
+}
+
+
+__attribute__((target("avx2")))
+static uint FindE8_AVX2(const byte *Data,uint Pos,uint Border,byte CmpByte2)
+{
+  __m256i E8=_mm256_set1_epi8((char)0xe8),Cmp2=_mm256_set1_epi8((char)CmpByte2);
+  for (;Pos+32<=Border;Pos+=32)
+  {
+    __m256i D=_mm256_loadu_si256((const __m256i *)(Data+Pos));
+    uint Mask=_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(D,E8),_mm256_cmpeq_epi8(D,Cmp2)));
+    if (Mask!=0)
+      return(Pos+__builtin_ctz(Mask));
+  }
+  return(FindE8_SSE2(Data,Pos,Border,CmpByte2));
+}
+
+
+// Subtract running sums of 16 source bytes from the last decoded byte,
+// which Prev holds in all lanes, and put the last new byte to Prev.
+static inline __m128i DeltaBlock_SSE2(__m128i Src,__m128i &Prev)
+{
+  Src=_mm_add_epi8(Src,_mm_slli_si128(Src,1));
+  Src=_mm_add_epi8(Src,_mm_slli_si128(Src,2));
+  Src=_mm_add_epi8(Src,_mm_slli_si128(Src,4));
+  Src=_mm_add_epi8(Src,_mm_slli_si128(Src,8));
+  __m128i Out=_mm_sub_epi8(Prev,Src);
+  __m128i Last=_mm_shufflehi_epi16(_mm_unpackhi_epi8(Out,Out),0xff);
+  Prev=_mm_unpackhi_epi64(Last,Last);
+  return(Out);
+}
+
+
+// Delta filter for 1, 2 or 4 channels. Channels are decoded 16 bytes
+// at once and interleaved back with unpack instructions.
+static void DeltaDecode_SSE2(const byte *Src,byte *Dest,uint DataSize,uint Channels)
+{
+  uint Count=DataSize/Channels,Rem=DataSize%Channels;
+  const byte *ChSrc[4];
+  __m128i Prev[4],V[4];
+  for (uint C=0;C<Channels;C++)
+  {
+    ChSrc[C]=Src+C*Count+Min(C,Rem);
+    Prev[C]=_mm_setzero_si128();
+  }
+
+  uint Done=Count & ~15;
+  for (uint Pos=0;Pos<Done;Pos+=16)
+  {
+    for (uint C=0;C<Channels;C++)
+      V[C]=DeltaBlock_SSE2(_mm_loadu_si128((const __m128i *)(ChSrc[C]+Pos)),Prev[C]);
+    __m128i *Out=(__m128i *)(Dest+Pos*Channels);
+    if (Channels==1)
+      _mm_storeu_si128(Out,V[0]);
+    else
+      if (Channels==2)
+      {
+        _mm_storeu_si128(Out,_mm_unpacklo_epi8(V[0],V[1]));
+        _mm_storeu_si128(Out+1,_mm_unpackhi_epi8(V[0],V[1]));
+      }
+      else
+      {
+        __m128i L01=_mm_unpacklo_epi8(V[0],V[1]),H01=_mm_unpackhi_epi8(V[0],V[1]);
+        __m128i L23=_mm_unpacklo_epi8(V[2],V[3]),H23=_mm_unpackhi_epi8(V[2],V[3]);
+        _mm_storeu_si128(Out,_mm_unpacklo_epi16(L01,L23));
+        _mm_storeu_si128(Out+1,_mm_unpackhi_epi16(L01,L23));
+        _mm_storeu_si128(Out+2,_mm_unpacklo_epi16(H01,H23));
+        _mm_storeu_si128(Out+3,_mm_unpackhi_epi16(H01,H23));
+      }
+  }
+
+  // Remaining bytes of every channel, including the extra one of first
+  // Rem channels.
+  for (uint C=0;C<Channels;C++)
+  {
+    byte PrevByte=(byte)_mm_cvtsi128_si32(Prev[C]);
+    const byte *S=ChSrc[C]+Done;
+    for (uint DestPos=Done*Channels+C;DestPos<DataSize;DestPos+=Channels)
+      Dest[DestPos]=(PrevByte-=*(S++));
+  }
+}
+
+
+// RGB filter for Width divisible by 3, when upper and upper left bytes
+// belong to the same channel as the predicted one. It allows to predict
+// all three channels of a pixel together in 16 bit lanes.
+static void RGBDecode_SSE2(const byte *Src,byte *Dest,uint DataSize,uint Width)
+{
+  const uint Channels=3;
+  uint Count=DataSize/Channels,Rem=DataSize%Channels;
+  const byte *ChSrc[Channels];
+  for (uint C=0;C<Channels;C++)
+    ChSrc[C]=Src+C*Count+Min(C,Rem);
+
+  __m128i Zero=_mm_setzero_si128(),ByteMask=_mm_set1_epi16(0xff);
+  __m128i A=Zero; // Previous pixel.
+  for (uint P=0,I=0;P<Count;P++,I+=Channels)
+  {
+    __m128i S=_mm_setr_epi16(ChSrc[0][P],ChSrc[1][P],ChSrc[2][P],0,0,0,0,0);
+    __m128i Predicted=A;
+    if (I>=Width+3)
+    {
+      // Upper and upper left pixels. The fourth lane is not used.
+      const byte *UpperData=Dest+I-Width;
+      uint32 UpperPixel,UpperLeftPixel;
+      memcpy(&UpperPixel,UpperData,4);
+      memcpy(&UpperLeftPixel,UpperData-3,4);
+      __m128i B=_mm_unpacklo_epi8(_mm_cvtsi32_si128(UpperPixel),Zero);
+      __m128i C=_mm_unpacklo_epi8(_mm_cvtsi32_si128(UpperLeftPixel),Zero);
+
+      __m128i DifA=_mm_sub_epi16(B,C),DifB=_mm_sub_epi16(A,C);
+      __m128i DifC=_mm_add_epi16(DifA,DifB);
+      __m128i PA=_mm_max_epi16(DifA,_mm_sub_epi16(Zero,DifA));
+      __m128i PB=_mm_max_epi16(DifB,_mm_sub_epi16(Zero,DifB));
+      __m128i PC=_mm_max_epi16(DifC,_mm_sub_epi16(Zero,DifC));
+
+      __m128i NotA=_mm_or_si128(_mm_cmpgt_epi16(PA,PB),_mm_cmpgt_epi16(PA,PC));
+      __m128i UseC=_mm_cmpgt_epi16(PB,PC);
+      __m128i BorC=_mm_or_si128(_mm_and_si128(UseC,C),_mm_andnot_si128(UseC,B));
+      Predicted=_mm_or_si128(_mm_and_si128(NotA,BorC),_mm_andnot_si128(NotA,A));
+    }
+    A=_mm_and_si128(_mm_sub_epi16(Predicted,S),ByteMask);
+    uint Pixel=_mm_cvtsi128_si32(_mm_packus_epi16(A,A));
+    Dest[I]=(byte)Pixel;
+    Dest[I+1]=(byte)(Pixel>>8);
+    Dest[I+2]=(byte)(Pixel>>16);
+  }
+
+  // Last incomplete pixel.
+  ushort LastPixel[8];
+  _mm_storeu_si128((__m128i *)LastPixel,A);
+  for (uint C=0;C<Rem;C++)
+  {
+    uint I=Count*Channels+C;
+    uint PrevByte=LastPixel[C];
+    uint Predicted=PrevByte;
+    if (I>=Width+3)
+    {
+      uint UpperByte=Dest[I-Width],UpperLeftByte=Dest[I-Width-3];
+      Predicted=PrevByte+UpperByte-UpperLeftByte;
+      int pa=abs((int)(Predicted-PrevByte));
+      int pb=abs((int)(Predicted-UpperByte));
+      int pc=abs((int)(Predicted-UpperLeftByte));
+      if (pa<=pb && pa<=pc)
+        Predicted=PrevByte;
+      else
+        if (pb<=pc)
+          Predicted=UpperByte;
+        else
+          Predicted=UpperLeftByte;
+    }
+    Dest[I]=(byte)(Predicted-ChSrc[C][Count]);
+  }
+}
+#endif
+
+
 void RarVM::ExecuteStandardFilter(VM_StandardFilters FilterType)
 {
   switch(FilterType)
@@ -873,217 +1126,45 @@ void RarVM::ExecuteStandardFilter(VM_StandardFilters FilterType)
     case VMSF_E8:
     case VMSF_E8E9:
       {
-        byte *Data=Mem;
         int DataSize=R[4];
-        uint FileOffset=R[6];
-
         if ((uint)DataSize>=VM_GLOBALMEMADDR || DataSize<4)
           break;
-
-        const int FileSize=0x1000000;
-        byte CmpByte2=FilterType==VMSF_E8E9 ? 0xe9:0xe8;
-        for (int CurPos=0;CurPos<DataSize-4;)
-        {
-          byte CurByte=*(Data++);
-          CurPos++;
-          if (CurByte==0xe8 || CurByte==CmpByte2)
-          {
-#ifdef PRESENT_INT32
-            int32 Offset=CurPos+FileOffset;
-            int32 Addr=GET_VALUE(false,Data);
-            if (Addr<0)
-            {
-              if (Addr+Offset>=0)
-                SET_VALUE(false,Data,Addr+FileSize);
-            }
-            else
-              if (Addr<FileSize)
-                SET_VALUE(false,Data,Addr-Offset);
-#else
-            long Offset=CurPos+FileOffset;
-            long Addr=GET_VALUE(false,Data);
-            if ((Addr & 0x80000000)!=0)
-            {
-              if (((Addr+Offset) & 0x80000000)==0)
-                SET_VALUE(false,Data,Addr+FileSize);
-            }
-            else 
-              if (((Addr-FileSize) & 0x80000000)!=0)
-                SET_VALUE(false,Data,Addr-Offset);
-#endif
-            Data+=4;
-            CurPos+=4;
-          }
-        }
+        FilterE8(Mem,Mem,DataSize,R[6],FilterType==VMSF_E8E9);
       }
       break;
     case VMSF_ITANIUM:
       {
-        byte *Data=Mem;
         int DataSize=R[4];
-        uint FileOffset=R[6];
-
         if ((uint)DataSize>=VM_GLOBALMEMADDR || DataSize<21)
           break;
-
-        int CurPos=0;
-
-        FileOffset>>=4;
-
-        while (CurPos<DataSize-21)
-        {
-          int Byte=(Data[0]&0x1f)-0x10;
-          if (Byte>=0)
-          {
-            static byte Masks[16]={4,4,6,6,0,0,7,7,4,4,0,0,4,4,0,0};
-            byte CmdMask=Masks[Byte];
-            if (CmdMask!=0)
-              for (int I=0;I<=2;I++)
-                if (CmdMask & (1<<I))
-                {
-                  int StartPos=I*41+5;
-                  int OpType=FilterItanium_GetBits(Data,StartPos+37,4);
-                  if (OpType==5)
-                  {
-                    int Offset=FilterItanium_GetBits(Data,StartPos+13,20);
-                    FilterItanium_SetBits(Data,(Offset-FileOffset)&0xfffff,StartPos+13,20);
-                  }
-                }
-          }
-          Data+=16;
-          CurPos+=16;
-          FileOffset++;
-        }
+        FilterItanium(Mem,DataSize,R[6]);
       }
       break;
     case VMSF_DELTA:
       {
-        int DataSize=R[4],Channels=R[0],SrcPos=0,Border=DataSize*2;
+        int DataSize=R[4];
         SET_VALUE(false,&Mem[VM_GLOBALMEMADDR+0x20],DataSize);
         if ((uint)DataSize>=VM_GLOBALMEMADDR/2)
           break;
-
-        // Bytes from same channels are grouped to continual data blocks,
-        // so we need to place them back to their interleaving positions.
-        for (int CurChannel=0;CurChannel<Channels;CurChannel++)
-        {
-          byte PrevByte=0;
-          for (int DestPos=DataSize+CurChannel;DestPos<Border;DestPos+=Channels)
-            Mem[DestPos]=(PrevByte-=Mem[SrcPos++]);
-        }
+        FilterDelta(Mem,Mem+DataSize,DataSize,R[0]);
       }
       break;
     case VMSF_RGB:
       {
         int DataSize=R[4],Width=R[0]-3,PosR=R[1];
-        byte *SrcData=Mem,*DestData=SrcData+DataSize;
-        const int Channels=3;
         SET_VALUE(false,&Mem[VM_GLOBALMEMADDR+0x20],DataSize);
         if ((uint)DataSize>=VM_GLOBALMEMADDR/2 || PosR<0)
           break;
-        for (int CurChannel=0;CurChannel<Channels;CurChannel++)
-        {
-          uint PrevByte=0;
-
-          for (int I=CurChannel;I<DataSize;I+=Channels)
-          {
-            uint Predicted;
-            int UpperPos=I-Width;
-            if (UpperPos>=3)
-            {
-              byte *UpperData=DestData+UpperPos;
-              uint UpperByte=*UpperData;
-              uint UpperLeftByte=*(UpperData-3);
-              Predicted=PrevByte+UpperByte-UpperLeftByte;
-              int pa=abs((int)(Predicted-PrevByte));
-              int pb=abs((int)(Predicted-UpperByte));
-              int pc=abs((int)(Predicted-UpperLeftByte));
-              if (pa<=pb && pa<=pc)
-                Predicted=PrevByte;
-              else
-                if (pb<=pc)
-                  Predicted=UpperByte;
-                else
-                  Predicted=UpperLeftByte;
-            }
-            else
-              Predicted=PrevByte;
-            DestData[I]=PrevByte=(byte)(Predicted-*(SrcData++));
-          }
-        }
-        for (int I=PosR,Border=DataSize-2;I<Border;I+=3)
-        {
-          byte G=DestData[I+1];
-          DestData[I]+=G;
-          DestData[I+2]+=G;
-        }
+        FilterRGB(Mem,Mem+DataSize,DataSize,Width,PosR);
       }
       break;
     case VMSF_AUDIO:
       {
-        int DataSize=R[4],Channels=R[0];
-        byte *SrcData=Mem,*DestData=SrcData+DataSize;
+        int DataSize=R[4];
         SET_VALUE(false,&Mem[VM_GLOBALMEMADDR+0x20],DataSize);
         if ((uint)DataSize>=VM_GLOBALMEMADDR/2)
           break;
-        for (int CurChannel=0;CurChannel<Channels;CurChannel++)
-        {
-          uint PrevByte=0,PrevDelta=0,Dif[7];
-          int D1=0,D2=0,D3;
-          int K1=0,K2=0,K3=0;
-          memset(Dif,0,sizeof(Dif));
-
-          for (int I=CurChannel,ByteCount=0;I<DataSize;I+=Channels,ByteCount++)
-          {
-            D3=D2;
-            D2=PrevDelta-D1;
-            D1=PrevDelta;
-
-            uint Predicted=8*PrevByte+K1*D1+K2*D2+K3*D3;
-            Predicted=(Predicted>>3) & 0xff;
-
-            uint CurByte=*(SrcData++);
-
-            Predicted-=CurByte;
-            DestData[I]=Predicted;
-            PrevDelta=(signed char)(Predicted-PrevByte);
-            PrevByte=Predicted;
-
-            int D=((signed char)CurByte)<<3;
-
-            Dif[0]+=abs(D);
-            Dif[1]+=abs(D-D1);
-            Dif[2]+=abs(D+D1);
-            Dif[3]+=abs(D-D2);
-            Dif[4]+=abs(D+D2);
-            Dif[5]+=abs(D-D3);
-            Dif[6]+=abs(D+D3);
-
-            if ((ByteCount & 0x1f)==0)
-            {
-              uint MinDif=Dif[0],NumMinDif=0;
-              Dif[0]=0;
-              for (int J=1;J<sizeof(Dif)/sizeof(Dif[0]);J++)
-              {
-                if (Dif[J]<MinDif)
-                {
-                  MinDif=Dif[J];
-                  NumMinDif=J;
-                }
-                Dif[J]=0;
-              }
-              switch(NumMinDif)
-              {
-                case 1: if (K1>=-16) K1--; break;
-                case 2: if (K1 < 16) K1++; break;
-                case 3: if (K2>=-16) K2--; break;
-                case 4: if (K2 < 16) K2++; break;
-                case 5: if (K3>=-16) K3--; break;
-                case 6: if (K3 < 16) K3++; break;
-              }
-            }
-          }
-        }
+        FilterAudio(Mem,Mem+DataSize,DataSize,R[0]);
       }
       break;
     case VMSF_UPCASE:
@@ -1106,6 +1187,285 @@ void RarVM::ExecuteStandardFilter(VM_StandardFilters FilterType)
 }
 
 
+// Apply a standard filter to DataSize bytes at Src and place the result
+// to Dest, without copying data to VM memory. Param holds the filter
+// registers. Returns false if the filter or its parameters are not
+// supported here and the block must be processed by VM.
+bool RarVM::ApplyStandardFilter(VM_StandardFilters FilterType,uint *Param,
+     byte *Src,byte *Dest,uint DataSize,uint FileOffset)
+{
+  switch(FilterType)
+  {
+    case VMSF_E8:
+    case VMSF_E8E9:
+      if (DataSize>=VM_GLOBALMEMADDR || DataSize<4)
+        return(false);
+      FilterE8(Src,Dest,DataSize,FileOffset,FilterType==VMSF_E8E9);
+      return(true);
+    case VMSF_ITANIUM:
+      if (DataSize>=VM_GLOBALMEMADDR || DataSize<21)
+        return(false);
+      memcpy(Dest,Src,DataSize);
+      FilterItanium(Dest,DataSize,FileOffset);
+      return(true);
+    case VMSF_DELTA:
+      // Without channels Dest keeps what was in VM memory before.
+      if (DataSize>=VM_GLOBALMEMADDR/2 || (int)Param[0]<=0)
+        return(false);
+      FilterDelta(Src,Dest,DataSize,Param[0]);
+      return(true);
+    case VMSF_RGB:
+      {
+        // Other widths make the filter read bytes of Dest which are not
+        // written yet and contain whatever was in VM memory before.
+        int Width=Param[0]-3;
+        if (DataSize>=VM_GLOBALMEMADDR/2 || (int)Param[1]<0 || Width<3 || Width%3!=0)
+          return(false);
+        FilterRGB(Src,Dest,DataSize,Width,Param[1]);
+      }
+      return(true);
+    case VMSF_AUDIO:
+      if (DataSize>=VM_GLOBALMEMADDR/2 || (int)Param[0]<=0)
+        return(false);
+      FilterAudio(Src,Dest,DataSize,Param[0]);
+      return(true);
+    default:
+      return(false);
+  }
+}
+
+
+static inline uint FindE8(const byte *Data,uint Pos,uint Border,byte CmpByte2)
+{
+#ifdef USE_SSE
+  if (_SSE_Version>=SSE_AVX2)
+    return(FindE8_AVX2(Data,Pos,Border,CmpByte2));
+  if (_SSE_Version>=SSE_SSE2)
+    return(FindE8_SSE2(Data,Pos,Border,CmpByte2));
+#endif
+  while (Pos<Border && Data[Pos]!=0xe8 && Data[Pos]!=CmpByte2)
+    Pos++;
+  return(Pos);
+}
+
+
+// Src and Dest can be the same. Otherwise bytes between addresses are
+// copied while searching for the next one.
+void RarVM::FilterE8(byte *Src,byte *Dest,uint DataSize,uint FileOffset,bool E8E9)
+{
+  const int FileSize=0x1000000;
+  byte CmpByte2=E8E9 ? 0xe9:0xe8;
+  uint CurPos=0,Border=DataSize-4;
+  while (CurPos<Border)
+  {
+    uint Next=FindE8(Src,CurPos,Border,CmpByte2);
+    if (Src!=Dest)
+      memcpy(Dest+CurPos,Src+CurPos,Next-CurPos);
+    CurPos=Next;
+    if (CurPos>=Border)
+      break;
+    Dest[CurPos]=Src[CurPos];
+    CurPos++;
+
+    byte *Data=Src+CurPos;
+    uint32 Addr=(uint32)Data[0]|((uint32)Data[1]<<8)|((uint32)Data[2]<<16)|((uint32)Data[3]<<24);
+#ifdef PRESENT_INT32
+    int32 Offset=CurPos+FileOffset;
+    if ((int32)Addr<0)
+    {
+      if ((int32)Addr+Offset>=0)
+        Addr+=FileSize;
+    }
+    else
+      if ((int32)Addr<FileSize)
+        Addr-=Offset;
+#else
+    long Offset=CurPos+FileOffset;
+    if ((Addr & 0x80000000)!=0)
+    {
+      if (((Addr+Offset) & 0x80000000)==0)
+        Addr+=FileSize;
+    }
+    else 
+      if (((Addr-FileSize) & 0x80000000)!=0)
+        Addr-=Offset;
+#endif
+    Data=Dest+CurPos;
+    Data[0]=(byte)Addr;
+    Data[1]=(byte)(Addr>>8);
+    Data[2]=(byte)(Addr>>16);
+    Data[3]=(byte)(Addr>>24);
+    CurPos+=4;
+  }
+  if (Src!=Dest && CurPos<DataSize)
+    memcpy(Dest+CurPos,Src+CurPos,DataSize-CurPos);
+}
+
+
+void RarVM::FilterItanium(byte *Data,int DataSize,uint FileOffset)
+{
+  int CurPos=0;
+
+  FileOffset>>=4;
+
+  while (CurPos<DataSize-21)
+  {
+    int Byte=(Data[0]&0x1f)-0x10;
+    if (Byte>=0)
+    {
+      static byte Masks[16]={4,4,6,6,0,0,7,7,4,4,0,0,4,4,0,0};
+      byte CmdMask=Masks[Byte];
+      if (CmdMask!=0)
+        for (int I=0;I<=2;I++)
+          if (CmdMask & (1<<I))
+          {
+            int StartPos=I*41+5;
+            int OpType=FilterItanium_GetBits(Data,StartPos+37,4);
+            if (OpType==5)
+            {
+              int Offset=FilterItanium_GetBits(Data,StartPos+13,20);
+              FilterItanium_SetBits(Data,(Offset-FileOffset)&0xfffff,StartPos+13,20);
+            }
+          }
+    }
+    Data+=16;
+    CurPos+=16;
+    FileOffset++;
+  }
+}
+
+
+void RarVM::FilterDelta(byte *Src,byte *Dest,int DataSize,int Channels)
+{
+#ifdef USE_SSE
+  if (_SSE_Version>=SSE_SSE2 && (Channels==1 || Channels==2 || Channels==4))
+  {
+    DeltaDecode_SSE2(Src,Dest,DataSize,Channels);
+    return;
+  }
+#endif
+
+  // Bytes from same channels are grouped to continual data blocks,
+  // so we need to place them back to their interleaving positions.
+  for (int CurChannel=0;CurChannel<Channels;CurChannel++)
+  {
+    byte PrevByte=0;
+    for (int DestPos=CurChannel;DestPos<DataSize;DestPos+=Channels)
+      Dest[DestPos]=(PrevByte-=*(Src++));
+  }
+}
+
+
+void RarVM::FilterRGB(byte *SrcData,byte *DestData,int DataSize,int Width,int PosR)
+{
+  const int Channels=3;
+#ifdef USE_SSE
+  if (_SSE_Version>=SSE_SSE2 && Width>=3 && Width%3==0)
+    RGBDecode_SSE2(SrcData,DestData,DataSize,Width);
+  else
+#endif
+  for (int CurChannel=0;CurChannel<Channels;CurChannel++)
+  {
+    uint PrevByte=0;
+
+    for (int I=CurChannel;I<DataSize;I+=Channels)
+    {
+      uint Predicted;
+      int UpperPos=I-Width;
+      if (UpperPos>=3)
+      {
+        byte *UpperData=DestData+UpperPos;
+        uint UpperByte=*UpperData;
+        uint UpperLeftByte=*(UpperData-3);
+        Predicted=PrevByte+UpperByte-UpperLeftByte;
+        int pa=abs((int)(Predicted-PrevByte));
+        int pb=abs((int)(Predicted-UpperByte));
+        int pc=abs((int)(Predicted-UpperLeftByte));
+        if (pa<=pb && pa<=pc)
+          Predicted=PrevByte;
+        else
+          if (pb<=pc)
+            Predicted=UpperByte;
+          else
+            Predicted=UpperLeftByte;
+      }
+      else
+        Predicted=PrevByte;
+      DestData[I]=PrevByte=(byte)(Predicted-*(SrcData++));
+    }
+  }
+  for (int I=PosR,Border=DataSize-2;I<Border;I+=3)
+  {
+    byte G=DestData[I+1];
+    DestData[I]+=G;
+    DestData[I+2]+=G;
+  }
+}
+
+
+void RarVM::FilterAudio(byte *SrcData,byte *DestData,int DataSize,int Channels)
+{
+  for (int CurChannel=0;CurChannel<Channels;CurChannel++)
+  {
+    uint PrevByte=0,PrevDelta=0,Dif[7];
+    int D1=0,D2=0,D3;
+    int K1=0,K2=0,K3=0;
+    memset(Dif,0,sizeof(Dif));
+
+    for (int I=CurChannel,ByteCount=0;I<DataSize;I+=Channels,ByteCount++)
+    {
+      D3=D2;
+      D2=PrevDelta-D1;
+      D1=PrevDelta;
+
+      uint Predicted=8*PrevByte+K1*D1+K2*D2+K3*D3;
+      Predicted=(Predicted>>3) & 0xff;
+
+      uint CurByte=*(SrcData++);
+
+      Predicted-=CurByte;
+      DestData[I]=Predicted;
+      PrevDelta=(signed char)(Predicted-PrevByte);
+      PrevByte=Predicted;
+
+      int D=((signed char)CurByte)<<3;
+
+      Dif[0]+=abs(D);
+      Dif[1]+=abs(D-D1);
+      Dif[2]+=abs(D+D1);
+      Dif[3]+=abs(D-D2);
+      Dif[4]+=abs(D+D2);
+      Dif[5]+=abs(D-D3);
+      Dif[6]+=abs(D+D3);
+
+      if ((ByteCount & 0x1f)==0)
+      {
+        uint MinDif=Dif[0],NumMinDif=0;
+        Dif[0]=0;
+        for (int J=1;J<sizeof(Dif)/sizeof(Dif[0]);J++)
+        {
+          if (Dif[J]<MinDif)
+          {
+            MinDif=Dif[J];
+            NumMinDif=J;
+          }
+          Dif[J]=0;
+        }
+        switch(NumMinDif)
+        {
+          case 1: if (K1>=-16) K1--; break;
+          case 2: if (K1 < 16) K1++; break;
+          case 3: if (K2>=-16) K2--; break;
+          case 4: if (K2 < 16) K2++; break;
+          case 5: if (K3>=-16) K3--; break;
+          case 6: if (K3 < 16) K3++; break;
+        }
+      }
+    }
+  }
+}
+
+
 uint RarVM::FilterItanium_GetBits(byte *Data,int BitPos,int BitCount)
 {
   int InAddr=BitPos/8;
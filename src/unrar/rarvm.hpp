@@ -63,6 +63,7 @@ struct VM_PreparedProgram
   {
     AltCmd=NULL;
     FilteredDataSize=0;
+    Type=VMSF_NONE;
     CmdCount=0;
   }
 
@@ -74,6 +75,9 @@ struct VM_PreparedProgram
   Array<byte> StaticData; // static data contained in DB operators
   uint InitR[7];
 
+  // Standard filter recognized by Prepare or VMSF_NONE.
+  VM_StandardFilters Type;
+
   byte *FilteredData;
   uint FilteredDataSize;
 };
@@ -88,10 +92,15 @@ class RarVM:private BitInput
 #ifdef VM_OPTIMIZE
     void Optimize(VM_PreparedProgram *Prg);
 #endif
-    bool ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize);
+    template<bool Threaded> bool ExecuteCode(VM_PreparedCommand *PreparedCode,uint CodeSize);
 #ifdef VM_STANDARDFILTERS
     VM_StandardFilters IsStandardFilter(byte *Code,uint CodeSize);
     void ExecuteStandardFilter(VM_StandardFilters FilterType);
+    void FilterE8(byte *Src,byte *Dest,uint DataSize,uint FileOffset,bool E8E9);
+    void FilterItanium(byte *Data,int DataSize,uint FileOffset);
+    void FilterDelta(byte *Src,byte *Dest,int DataSize,int Channels);
+    void FilterRGB(byte *SrcData,byte *DestData,int DataSize,int Width,int PosR);
+    void FilterAudio(byte *SrcData,byte *DestData,int DataSize,int Channels);
     uint FilterItanium_GetBits(byte *Data,int BitPos,int BitCount);
     void FilterItanium_SetBits(byte *Data,uint BitField,int BitPos,int BitCount);
 #endif
@@ -99,6 +108,7 @@ class RarVM:private BitInput
     byte *Mem;
     uint R[8];
     uint Flags;
+    bool ThreadedCode;
   public:
     RarVM();
     ~RarVM();
@@ -107,6 +117,13 @@ class RarVM:private BitInput
     void Execute(VM_PreparedProgram *Prg);
     void SetLowEndianValue(uint *Addr,uint Value);
     void SetMemory(uint Pos,byte *Data,uint DataSize);
+    // Threaded dispatch is on by default where the compiler has it, off
+    // runs generic programs through the switch loop.
+    void SetThreadedCode(bool Threaded) {ThreadedCode=Threaded;}
+#ifdef VM_STANDARDFILTERS
+    bool ApplyStandardFilter(VM_StandardFilters FilterType,uint *Param,
+         byte *Src,byte *Dest,uint DataSize,uint FileOffset);
+#endif
     static uint ReadData(BitInput &Inp);
 };
 
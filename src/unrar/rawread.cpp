@@ -96,6 +96,23 @@ void RawRead::Get8(int64 &Field)
 }
 
 
+// RAR 5.0 variable length integer: 7 bits per byte, lowest first, with
+// the high bit set in every byte but the last. Returns 0 if the data ends
+// before the integer does.
+uint64 RawRead::GetV()
+{
+  uint64 Result=0;
+  for (uint Shift=0;ReadPos<DataSize && Shift<64;Shift+=7)
+  {
+    byte CurByte=Data[ReadPos++];
+    Result+=uint64(CurByte & 0x7f)<<Shift;
+    if ((CurByte & 0x80)==0)
+      return(Result);
+  }
+  return(0);
+}
+
+
 void RawRead::Get(byte *Field,size_t Size)
 {
   if (ReadPos+Size-1<DataSize)
@@ -124,3 +141,10 @@ uint RawRead::GetCRC(bool ProcessedOnly)
 {
   return(DataSize>2 ? CRC(0xffffffff,&Data[2],(ProcessedOnly ? ReadPos:DataSize)-2):0xffffffff);
 }
+
+
+// RAR 5.0 header CRC32, which covers everything after the CRC field.
+uint RawRead::GetCRC50()
+{
+  return(DataSize>4 ? ~CRC(0xffffffff,&Data[4],DataSize-4):0xffffffff);
+}
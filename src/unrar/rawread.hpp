@@ -19,10 +19,14 @@ class RawRead
     void Get(ushort &Field);
     void Get(uint &Field);
     void Get8(int64 &Field);
+    uint64 GetV();
     void Get(byte *Field,size_t Size);
     void Get(wchar *Field,size_t Size);
     uint GetCRC(bool ProcessedOnly);
+    uint GetCRC50();
     size_t Size() {return DataSize;}
+    size_t GetPos() {return ReadPos;}
+    void SetPos(size_t Pos) {ReadPos=Pos;}
     size_t PaddedSize() {return Data.Size()-DataSize;}
 #ifndef SHELL_EXT
     void SetCrypt(CryptData *Crypt) {RawRead::Crypt=Crypt;}
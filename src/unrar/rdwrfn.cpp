@@ -125,6 +125,9 @@ void ComprDataIO::UnpWrite(byte *Addr,size_t Count)
   RAROptions *Cmd=((Archive *)SrcFile)->GetRAROptions();
   if (Cmd->DllOpMode!=RAR_SKIP)
   {
+    if (Cmd->DataSink!=NULL &&
+        Cmd->DataSink->Write(Cmd->DataSink->Opaque,Addr,Count)==0)
+      ErrHandler.Exit(RARX_USERBREAK);
     if (Cmd->Callback!=NULL &&
         Cmd->Callback(UCM_PROCESSDATA,Cmd->UserData,(LPARAM)Addr,Count)==-1)
       ErrHandler.Exit(RARX_USERBREAK);
@@ -160,11 +163,19 @@ void ComprDataIO::UnpWrite(byte *Addr,size_t Count)
 
   UnpWrAddr=Addr;
   UnpWrSize=Count;
+  bool CRCDone=SkipUnpCRC;
   if (UnpackToMemory)
   {
     if (Count <= UnpackToMemorySize)
     {
-      memcpy(UnpackToMemoryAddr,Addr,Count);
+      // Copy and update the CRC in one pass over the data.
+      if (!CRCDone && !((Archive *)SrcFile)->OldFormat)
+      {
+        UnpFileCRC=CRCCopy(UnpFileCRC,UnpackToMemoryAddr,Addr,Count);
+        CRCDone=true;
+      }
+      else
+        memcpy(UnpackToMemoryAddr,Addr,Count);
       UnpackToMemoryAddr+=Count;
       UnpackToMemorySize-=Count;
     }
@@ -173,7 +184,7 @@ void ComprDataIO::UnpWrite(byte *Addr,size_t Count)
     if (!TestMode)
       DestFile->Write(Addr,Count);
   CurUnpWrite+=Count;
-  if (!SkipUnpCRC)
+  if (!CRCDone)
 #ifndef SFX_MODULE
     if (((Archive *)SrcFile)->OldFormat)
       UnpFileCRC=OldCRC((ushort)UnpFileCRC,Addr,Count);
@@ -285,7 +296,7 @@ void ComprDataIO::SetCmt13Encryption()
 
 
 
-void ComprDataIO::SetUnpackToMemory(byte *Addr,uint Size)
+void ComprDataIO::SetUnpackToMemory(byte *Addr,size_t Size)
 {
   UnpackToMemory=true;
   UnpackToMemoryAddr=Addr;
@@ -61,9 +61,13 @@ class ComprDataIO
     void SetCommand(CmdAdd *Cmd) {Command=Cmd;}
     void SetSubHeader(FileHeader *hd,int64 *Pos) {SubHead=hd;SubHeadPos=Pos;}
     void SetEncryption(int Method,SecPassword *Password,const byte *Salt,bool Encrypt,bool HandsOffHash);
+#ifndef RAR_NOCRYPT
+    void KeepDecryptKey() {Decrypt.KeepKey();}
+#endif
     void SetAV15Encryption();
     void SetCmt13Encryption();
-    void SetUnpackToMemory(byte *Addr,uint Size);
+    void SetUnpackToMemory(byte *Addr,size_t Size);
+    void ResetUnpackToMemory() {UnpackToMemory=false;}
     void SetCurrentCommand(char Cmd) {CurrentCommand=Cmd;}
 
     bool PackVolume;
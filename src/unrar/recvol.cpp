@@ -3,13 +3,12 @@
 // Buffer size for all volumes involved.
 static const size_t TotalBufferSize=0x4000000;
 
-class RSEncode // Encode or decode data area, one object per one thread.
+class RSEncode // Encode data area, one object per one thread.
 {
   private:
     RSCoder RSC;
   public:
     void EncodeBuf();
-    void DecodeBuf();
 
     void Init(int RecVolNumber) {RSC.Init(RecVolNumber);}
     byte *Buf;
@@ -19,22 +18,55 @@ class RSEncode // Encode or decode data area, one object per one thread.
     int FileNumber;
     int RecVolNumber;
     size_t RecBufferSize;
-    int *Erasures;
-    int EraSize;
 };
 
 
-#ifdef RAR_SMP
-THREAD_PROC(RSEncodeThread)
+// Rebuilds the lost volumes in one stripe of the buffer. Stripes are
+// independent, so each thread takes one.
+struct RSStripe
 {
-  RSEncode *rs=(RSEncode *)Data;
-  rs->EncodeBuf();
+  RSCoder *RSC;
+  byte *Buf;
+  size_t RecBufferSize;
+  size_t Start,End;
+  int TotalFiles;
+  int *Erasures;
+  int EraSize;
+  byte *Matrix;
+  bool *WriteFlags;
+
+  void Decode();
+#ifdef _UNIX
+  static void* DecodeThread(void *Data) {((RSStripe *)Data)->Decode();return(NULL);}
+#endif
+};
+
+
+void RSStripe::Decode()
+{
+  // Go in blocks small enough for the rebuilt data to stay in cache
+  // while every source volume is added to it.
+  const size_t BlockSize=0x8000;
+  for (size_t BlockStart=Start;BlockStart<End;BlockStart+=BlockSize)
+  {
+    size_t Size=Min(BlockSize,End-BlockStart);
+    for (int I=0;I<EraSize;I++)
+    {
+      if (!WriteFlags[Erasures[I]])
+        continue;
+      byte *Dest=Buf+Erasures[I]*RecBufferSize+BlockStart;
+      for (int J=0;J<TotalFiles;J++)
+        RSC->MulAdd(Dest,Buf+J*RecBufferSize+BlockStart,Size,Matrix[I*TotalFiles+J]);
+    }
+  }
 }
 
-THREAD_PROC(RSDecodeThread)
+
+#ifdef RAR_SMP
+THREAD_PROC(RSEncodeThread)
 {
   RSEncode *rs=(RSEncode *)Data;
-  rs->DecodeBuf();
+  rs->EncodeBuf();
 }
 #endif
 
@@ -47,7 +79,7 @@ RecVolumes::RecVolumes()
 
 RecVolumes::~RecVolumes()
 {
-  for (int I=0;I<ASIZE(SrcFile);I++)
+  for (uint I=0;I<ASIZE(SrcFile);I++)
     delete SrcFile[I];
 }
 
@@ -82,6 +114,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
   {
     for (int DigitGroup=0;Ext>ArcName && DigitGroup<3;Ext--)
       if (!IsDigit(*Ext))
+      {
         if (IsDigit(*(Ext-1)) && (*Ext=='_' || DigitGroup<2))
           DigitGroup++;
         else
@@ -90,6 +123,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
             NewStyle=true;
             break;
           }
+      }
     while (IsDigit(*Ext) && Ext>ArcName+1)
       Ext--;
     strcpy(Ext,"*.*");
@@ -99,6 +133,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
       wchar *ExtW=GetExt(ArcNameW);
       for (int DigitGroup=0;ExtW>ArcNameW && DigitGroup<3;ExtW--)
         if (!IsDigit(*ExtW))
+        {
           if (IsDigit(*(ExtW-1)) && (*ExtW=='_' || DigitGroup<2))
             DigitGroup++;
           else
@@ -107,6 +142,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
               NewStyle=true;
               break;
             }
+        }
       while (IsDigit(*ExtW) && ExtW>ArcNameW+1)
         ExtW--;
       wcscpy(ExtW,L"*.*");
@@ -252,7 +288,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
       if (Dot==NULL)
         continue;
       bool WrongParam=false;
-      for (int I=0;I<ASIZE(P);I++)
+      for (uint I=0;I<ASIZE(P);I++)
       {
         do
         {
@@ -267,7 +303,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
     }
     if (P[1]+P[2]>255)
       continue;
-    if (RecVolNumber!=0 && RecVolNumber!=P[1] || FileNumber!=0 && FileNumber!=P[2])
+    if ((RecVolNumber!=0 && RecVolNumber!=P[1]) || (FileNumber!=0 && FileNumber!=P[2]))
     {
 #ifndef SILENT
       Log(NULL,St(MRecVolDiffSets),CurName,PrevName);
@@ -429,16 +465,26 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
   // Size of per file buffer.
   size_t RecBufferSize=TotalBufferSize/TotalFiles;
 
-#ifdef RAR_SMP
-  uint ThreadNumber=Cmd->Threads;
-  RSEncode rse[MaxPoolThreads];
-  uint WaitHandles[MaxPoolThreads];
-#else
+  // Rebuilt bytes are the same combination of the bytes left at every
+  // position, so the coefficients are found once for the whole set.
+  RSCoder RSC;
+  RSC.Init(RecVolNumber);
+  Array<byte> Matrix(EraSize*TotalFiles);
+  if (!RSC.DecodeMatrix(TotalFiles,Erasures,EraSize,&Matrix[0]))
+  {
+#ifndef SILENT
+    mprintf(St(MRecVolCannotFix));
+#endif
+    return(false);
+  }
+
+  const uint MaxStripes=16;
   uint ThreadNumber=1;
-  RSEncode rse[1];
+#ifdef _UNIX
+  long CPUs=sysconf(_SC_NPROCESSORS_ONLN);
+  if (CPUs>1)
+    ThreadNumber=Min((uint)CPUs,MaxStripes);
 #endif
-  for (uint I=0;I<ThreadNumber;I++)
-    rse[I].Init(RecVolNumber);
 
   while (true)
   {
@@ -450,7 +496,7 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
       else
       {
         int ReadSize=SrcFile[I]->Read(&Buf[I*RecBufferSize],RecBufferSize);
-        if (ReadSize!=RecBufferSize)
+        if (ReadSize!=(int)RecBufferSize)
           memset(&Buf[I*RecBufferSize+ReadSize],0,RecBufferSize-ReadSize);
         if (ReadSize>MaxRead)
           MaxRead=ReadSize;
@@ -466,50 +512,42 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
     }
     ProcessedSize+=MaxRead;
 #endif
-   
-
-    int BlockStart=0;
-    int BlockSize=MaxRead/ThreadNumber;
-    if (BlockSize<0x100)
-      BlockSize=MaxRead;
-    uint CurThread=0;
 
-    while (BlockStart<MaxRead)
+    // Split the data into one stripe per thread, but don't bother
+    // with threads for small amounts.
+    uint StripeCount=Min(ThreadNumber,(uint)(MaxRead/0x10000)+1);
+    size_t StripeSize=(MaxRead/StripeCount+0x3f) & ~(size_t)0x3f;
+    RSStripe Stripes[MaxStripes];
+    for (uint I=0;I<StripeCount;I++)
     {
-      // Last thread processes all left data including increasement
-      // from rounding error.
-      if (CurThread==ThreadNumber-1)
-        BlockSize=MaxRead-BlockStart;
-
-      RSEncode *curenc=rse+CurThread;
-      curenc->Buf=&Buf[0];
-      curenc->BufStart=BlockStart;
-      curenc->BufEnd=BlockStart+BlockSize;
-      curenc->FileNumber=TotalFiles;
-      curenc->RecBufferSize=RecBufferSize;
-      curenc->Erasures=Erasures;
-      curenc->EraSize=EraSize;
-
-#ifdef RAR_SMP
-      if (ThreadNumber>1)
-      {
-        uint Handle=RSThreadPool.Start(RSDecodeThread,(void*)curenc);
-        WaitHandles[CurThread++]=Handle;
-      }
+      RSStripe *Stripe=Stripes+I;
+      Stripe->RSC=&RSC;
+      Stripe->Buf=&Buf[0];
+      Stripe->RecBufferSize=RecBufferSize;
+      Stripe->Start=Min(I*StripeSize,(size_t)MaxRead);
+      Stripe->End=I==StripeCount-1 ? MaxRead:Min((I+1)*StripeSize,(size_t)MaxRead);
+      Stripe->TotalFiles=TotalFiles;
+      Stripe->Erasures=Erasures;
+      Stripe->EraSize=EraSize;
+      Stripe->Matrix=&Matrix[0];
+      Stripe->WriteFlags=WriteFlags;
+    }
+#ifdef _UNIX
+    pthread_t Threads[MaxStripes];
+    bool Started[MaxStripes];
+    for (uint I=1;I<StripeCount;I++)
+      Started[I]=pthread_create(&Threads[I],NULL,RSStripe::DecodeThread,Stripes+I)==0;
+    Stripes[0].Decode();
+    for (uint I=1;I<StripeCount;I++)
+      if (Started[I])
+        pthread_join(Threads[I],NULL);
       else
-        curenc->DecodeBuf();
+        Stripes[I].Decode();
 #else
-      curenc->DecodeBuf();
+    for (uint I=0;I<StripeCount;I++)
+      Stripes[I].Decode();
 #endif
 
-      BlockStart+=BlockSize;
-    }
-
-#ifdef RAR_SMP
-    if (CurThread>0)
-      RSThreadPool.Wait(WaitHandles,CurThread);
-#endif // RAR_SMP
-    
     for (int I=0;I<FileNumber;I++)
       if (WriteFlags[I])
         SrcFile[I]->Write(&Buf[I*RecBufferSize],MaxRead);
@@ -557,16 +595,3 @@ bool RecVolumes::Restore(RAROptions *Cmd,const char *Name,
   return(true);
 }
 
-
-void RSEncode::DecodeBuf()
-{
-  for (int BufPos=BufStart;BufPos<BufEnd;BufPos++)
-  {
-    byte Data[256];
-    for (int I=0;I<FileNumber;I++)
-      Data[I]=Buf[I*RecBufferSize+BufPos];
-    RSC.Decode(Data,FileNumber,Erasures,EraSize);
-    for (int I=0;I<EraSize;I++)
-      Buf[Erasures[I]*RecBufferSize+BufPos]=Data[Erasures[I]];
-  }
-}
@@ -14,6 +14,12 @@ static byte T1[256][4],T2[256][4],T3[256][4],T4[256][4];
 static byte T5[256][4],T6[256][4],T7[256][4],T8[256][4];
 static byte U1[256][4],U2[256][4],U3[256][4],U4[256][4];
 
+#ifdef USE_SSE
+// AES instructions aren't tied to any SSE level, so they are checked apart
+// from _SSE_Version.
+bool _AES_NI=(__builtin_cpu_init(),__builtin_cpu_supports("aes"));
+#endif
+
 
 inline void Xor128(byte *dest,const byte *arg1,const byte *arg2)
 {
@@ -61,8 +67,6 @@ inline void Copy128(byte *dest,const byte *src)
 
 Rijndael::Rijndael()
 {
-  if (S[0]==0)
-    GenerateTables();
 }
 
 
@@ -91,6 +95,14 @@ size_t Rijndael::blockDecrypt(const byte *input, size_t inputLen, byte *outBuffe
   if (input == 0 || inputLen <= 0)
     return 0;
 
+#ifdef USE_SSE
+  if (_AES_NI)
+  {
+    blockDecryptAES_NI(input,inputLen/16,outBuffer);
+    return 16*(inputLen/16);
+  }
+#endif
+
   byte block[16], iv[4][4];
   memcpy(iv,m_initVector,16); 
 
@@ -116,6 +128,61 @@ size_t Rijndael::blockDecrypt(const byte *input, size_t inputLen, byte *outBuffe
 }
 
 
+#ifdef USE_SSE
+// The decryption key schedule made by keyEncToDec is the one AESDEC expects,
+// so it is loaded as is. CBC decryption of a block doesn't depend on
+// decrypting the previous one, so four blocks go through the rounds
+// together to hide the instruction latency.
+__attribute__((target("aes,sse2")))
+void Rijndael::blockDecryptAES_NI(const byte *input,size_t numBlocks,byte *outBuffer)
+{
+  __m128i Key[_MAX_ROUNDS+1];
+  for (int r=0;r<=m_uRounds;r++)
+    Key[r]=_mm_loadu_si128((const __m128i *)m_expandedKey[r]);
+
+  __m128i IV=_mm_loadu_si128((const __m128i *)m_initVector);
+  for (;numBlocks>=4;numBlocks-=4,input+=64,outBuffer+=64)
+  {
+    __m128i In0=_mm_loadu_si128((const __m128i *)input);
+    __m128i In1=_mm_loadu_si128((const __m128i *)(input+16));
+    __m128i In2=_mm_loadu_si128((const __m128i *)(input+32));
+    __m128i In3=_mm_loadu_si128((const __m128i *)(input+48));
+    __m128i D0=_mm_xor_si128(In0,Key[m_uRounds]);
+    __m128i D1=_mm_xor_si128(In1,Key[m_uRounds]);
+    __m128i D2=_mm_xor_si128(In2,Key[m_uRounds]);
+    __m128i D3=_mm_xor_si128(In3,Key[m_uRounds]);
+    for (int r=m_uRounds-1;r>0;r--)
+    {
+      D0=_mm_aesdec_si128(D0,Key[r]);
+      D1=_mm_aesdec_si128(D1,Key[r]);
+      D2=_mm_aesdec_si128(D2,Key[r]);
+      D3=_mm_aesdec_si128(D3,Key[r]);
+    }
+    D0=_mm_xor_si128(_mm_aesdeclast_si128(D0,Key[0]),IV);
+    D1=_mm_xor_si128(_mm_aesdeclast_si128(D1,Key[0]),In0);
+    D2=_mm_xor_si128(_mm_aesdeclast_si128(D2,Key[0]),In1);
+    D3=_mm_xor_si128(_mm_aesdeclast_si128(D3,Key[0]),In2);
+    IV=In3;
+    // Input and output may be the same buffer, all input is read by now.
+    _mm_storeu_si128((__m128i *)outBuffer,D0);
+    _mm_storeu_si128((__m128i *)(outBuffer+16),D1);
+    _mm_storeu_si128((__m128i *)(outBuffer+32),D2);
+    _mm_storeu_si128((__m128i *)(outBuffer+48),D3);
+  }
+  for (;numBlocks>0;numBlocks--,input+=16,outBuffer+=16)
+  {
+    __m128i In=_mm_loadu_si128((const __m128i *)input);
+    __m128i D=_mm_xor_si128(In,Key[m_uRounds]);
+    for (int r=m_uRounds-1;r>0;r--)
+      D=_mm_aesdec_si128(D,Key[r]);
+    _mm_storeu_si128((__m128i *)outBuffer,_mm_xor_si128(_mm_aesdeclast_si128(D,Key[0]),IV));
+    IV=In;
+  }
+  _mm_storeu_si128((__m128i *)m_initVector,IV);
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ALGORITHM
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -266,7 +333,7 @@ void Rijndael::decrypt(const byte a[16], byte b[16])
 #define inv_affine(x) \
     (w = (uint)x, w = (w<<1)^(w<<3)^(w<<6), (byte)(0x05^(w^(w>>8))))
 
-void Rijndael::GenerateTables()
+static void GenerateTables()
 {
   unsigned char pow[512],log[256];
   int i = 0, w = 1; 
@@ -296,3 +363,11 @@ void Rijndael::GenerateTables()
     U1[b][0]=U2[b][1]=U3[b][2]=U4[b][3]=T5[i][0]=T6[i][1]=T7[i][2]=T8[i][3]=FFmul0e(b);
   }
 }
+
+
+// The tables are shared by all instances. Build them once at startup, so
+// no thread can read them while another one is still writing.
+static struct CallGenerateTables
+{
+  CallGenerateTables() {GenerateTables();}
+} CallGenerate;
@@ -13,6 +13,11 @@
 #define _MAX_ROUNDS      14
 #define MAX_IV_SIZE      16
 
+#ifdef USE_SSE
+// Set if the CPU has AES instructions. Clearing it selects the tables.
+extern bool _AES_NI;
+#endif
+
 class Rijndael
 {	
   public:
@@ -22,7 +27,9 @@ class Rijndael
     void keyEncToDec();
     void encrypt(const byte a[16], byte b[16]);
     void decrypt(const byte a[16], byte b[16]);
-    void GenerateTables();
+#ifdef USE_SSE
+    void blockDecryptAES_NI(const byte *input,size_t numBlocks,byte *outBuffer);
+#endif
 
     Direction m_direction;
     byte     m_initVector[MAX_IV_SIZE];
@@ -170,3 +170,100 @@ bool RSCoder::Decode(byte *Data,int DataSize,int *EraLoc,int EraSize)
     }
   return(ErrCount<=ParSize); // Return true if success.
 }
+
+
+// With the same erasures at every position, Decode is linear in the data:
+// every lost byte is the same GF(2^8) combination of the bytes left. Find
+// the coefficients once by decoding unit vectors, so the lost data can be
+// rebuilt with MulAdd over whole buffers instead of a Decode per byte.
+// Matrix gets EraSize rows of DataSize coefficients, 0 for erased columns.
+bool RSCoder::DecodeMatrix(int DataSize,int *EraLoc,int EraSize,byte *Matrix)
+{
+  bool Erased[MAXPAR+1];
+  memset(Erased,0,sizeof(Erased));
+  for (int I=0;I<EraSize;I++)
+    Erased[EraLoc[I]]=true;
+
+  for (int J=0;J<DataSize;J++)
+  {
+    byte Data[MAXPAR+1];
+    memset(Data,0,DataSize);
+    if (!Erased[J])
+    {
+      Data[J]=1;
+      if (!Decode(Data,DataSize,EraLoc,EraSize))
+        return(false);
+    }
+    for (int I=0;I<EraSize;I++)
+      Matrix[I*DataSize+J]=Data[EraLoc[I]];
+  }
+  return(true);
+}
+
+
+#ifdef USE_SSE
+// Multiply 16 bytes at a time by looking up the products of their low and
+// high nibbles with PSHUFB and adding them up.
+__attribute__((target("ssse3")))
+static size_t MulAdd_SSSE3(byte *Dest,const byte *Src,size_t Size,const byte *Lo,const byte *Hi)
+{
+  __m128i TabLo=_mm_loadu_si128((const __m128i *)Lo);
+  __m128i TabHi=_mm_loadu_si128((const __m128i *)Hi);
+  __m128i Mask=_mm_set1_epi8(0x0f);
+  size_t Pos=0;
+  for (;Pos+16<=Size;Pos+=16)
+  {
+    __m128i S=_mm_loadu_si128((const __m128i *)(Src+Pos));
+    __m128i PL=_mm_shuffle_epi8(TabLo,_mm_and_si128(S,Mask));
+    __m128i PH=_mm_shuffle_epi8(TabHi,_mm_and_si128(_mm_srli_epi64(S,4),Mask));
+    __m128i D=_mm_loadu_si128((const __m128i *)(Dest+Pos));
+    _mm_storeu_si128((__m128i *)(Dest+Pos),_mm_xor_si128(D,_mm_xor_si128(PL,PH)));
+  }
+  return(Pos);
+}
+
+
+__attribute__((target("avx2")))
+static size_t MulAdd_AVX2(byte *Dest,const byte *Src,size_t Size,const byte *Lo,const byte *Hi)
+{
+  __m256i TabLo=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)Lo));
+  __m256i TabHi=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)Hi));
+  __m256i Mask=_mm256_set1_epi8(0x0f);
+  size_t Pos=0;
+  for (;Pos+32<=Size;Pos+=32)
+  {
+    __m256i S=_mm256_loadu_si256((const __m256i *)(Src+Pos));
+    __m256i PL=_mm256_shuffle_epi8(TabLo,_mm256_and_si256(S,Mask));
+    __m256i PH=_mm256_shuffle_epi8(TabHi,_mm256_and_si256(_mm256_srli_epi64(S,4),Mask));
+    __m256i D=_mm256_loadu_si256((const __m256i *)(Dest+Pos));
+    _mm256_storeu_si256((__m256i *)(Dest+Pos),_mm256_xor_si256(D,_mm256_xor_si256(PL,PH)));
+  }
+  return(Pos+MulAdd_SSSE3(Dest+Pos,Src+Pos,Size-Pos,Lo,Hi));
+}
+#endif
+
+
+// Dest[I]^=Coef*Src[I] over GF(2^8) for Size bytes.
+void RSCoder::MulAdd(byte *Dest,const byte *Src,size_t Size,int Coef)
+{
+  if (Coef==0)
+    return;
+  // Products of Coef with every low and every high nibble. As the
+  // multiplication is linear, Coef*x is their sum for the two halves of x.
+  byte Lo[16],Hi[16];
+  for (int I=0;I<16;I++)
+  {
+    Lo[I]=gfMult(Coef,I);
+    Hi[I]=gfMult(Coef,I<<4);
+  }
+  size_t Pos=0;
+#ifdef USE_SSE
+  if (_SSE_Version>=SSE_AVX2)
+    Pos=MulAdd_AVX2(Dest,Src,Size,Lo,Hi);
+  else
+    if (_SSE_Version>=SSE_SSSE3)
+      Pos=MulAdd_SSSE3(Dest,Src,Size,Lo,Hi);
+#endif
+  for (;Pos<Size;Pos++)
+    Dest[Pos]^=Lo[Src[Pos] & 0xf]^Hi[Src[Pos]>>4];
+}
@@ -27,6 +27,8 @@ class RSCoder
     void Init(int ParSize);
     void Encode(byte *Data,int DataSize,byte *DestData);
     bool Decode(byte *Data,int DataSize,int *EraLoc,int EraSize);
+    bool DecodeMatrix(int DataSize,int *EraLoc,int EraSize,byte *Matrix);
+    void MulAdd(byte *Dest,const byte *Src,size_t Size,int Coef);
 };
 
 #endif
@@ -16,7 +16,7 @@ const wchar *NullToEmpty(const wchar *Str)
 
 char *IntNameToExt(const char *Name)
 {
-  static char OutName[NM];
+  static thread_local char OutName[NM];
   IntToExt(Name,OutName);
   return(OutName);
 }
@@ -5,6 +5,20 @@
  *  Contents: memory allocation routines                                    *
  ****************************************************************************/
 
+// Sub-allocator heaps are kept in a per-thread arena after use instead
+// of being freed, so the next file, archive or handle unpacked by this
+// thread does not allocate and fault in a new heap. The arena keeps the
+// largest heap released, as the larger one is going to be requested again.
+struct SubAllocatorArena
+{
+  byte *Heap;
+  uint Size;
+  ~SubAllocatorArena() {free(Heap);}
+};
+
+static thread_local SubAllocatorArena Arena;
+
+
 SubAllocator::SubAllocator()
 {
   Clean();
@@ -49,6 +63,22 @@ inline RAR_MEM_BLK* SubAllocator::MBPtr(RAR_MEM_BLK *BasePtr,int Items)
 }
 
 
+inline void SubAllocator::InsertBlock(RAR_MEM_BLK *p,RAR_MEM_BLK *Prev)
+{
+  RAR_MEM_BLK *Next=(RAR_MEM_BLK *)GetPtr(Prev->next);
+  p->prev=GetRef(Prev);
+  p->next=Prev->next;
+  Prev->next=Next->prev=GetRef(p);
+}
+
+
+inline void SubAllocator::RemoveBlock(RAR_MEM_BLK *p)
+{
+  ((RAR_MEM_BLK *)GetPtr(p->prev))->next=p->next;
+  ((RAR_MEM_BLK *)GetPtr(p->next))->prev=p->prev;
+}
+
+
 inline void SubAllocator::SplitBlock(void* pv,int OldIndx,int NewIndx)
 {
   int i, UDiff=Indx2Units[OldIndx]-Indx2Units[NewIndx];
@@ -70,7 +100,14 @@ void SubAllocator::StopSubAllocator()
   if ( SubAllocatorSize ) 
   {
     SubAllocatorSize=0;
-    free(HeapStart);
+    if (Arena.Heap==NULL || Arena.Size<HeapSize)
+    {
+      free(Arena.Heap);
+      Arena.Heap=HeapStart;
+      Arena.Size=HeapSize;
+    }
+    else
+      free(HeapStart);
   }
 }
 
@@ -87,10 +124,20 @@ bool SubAllocator::StartSubAllocator(int SASize)
   // units: one as reserve for HeapEnd overflow checks and another
   // to provide the space to correctly align UnitsStart.
   uint AllocSize=t/FIXED_UNIT_SIZE*UNIT_SIZE+2*UNIT_SIZE;
-  if ((HeapStart=(byte *)malloc(AllocSize)) == NULL)
+  if (Arena.Heap!=NULL && Arena.Size>=AllocSize)
   {
-    ErrHandler.MemoryError();
-    return FALSE;
+    HeapStart=Arena.Heap;
+    HeapSize=Arena.Size;
+    Arena.Heap=NULL;
+  }
+  else
+  {
+    if ((HeapStart=(byte *)malloc(AllocSize)) == NULL)
+    {
+      ErrHandler.MemoryError();
+      return FALSE;
+    }
+    HeapSize=AllocSize;
   }
 
   // HeapEnd did not present in original algorithm. We added it to control
@@ -166,27 +213,31 @@ void SubAllocator::InitSubAllocator()
 
 inline void SubAllocator::GlueFreeBlocks()
 {
-  RAR_MEM_BLK s0, * p, * p1;
+  // Blocks are linked by heap references, so the list head cannot be
+  // a local variable. We use the reserve unit at HeapEnd, which is never
+  // allocated. Its zero Stamp also stops gluing of the last block.
+  RAR_MEM_BLK *s0=(RAR_MEM_BLK *)HeapEnd, * p, * p1;
   int i, k, sz;
   if (LoUnit != HiUnit)
     *LoUnit=0;
-  for (i=0, s0.next=s0.prev=&s0;i < N_INDEXES;i++)
+  s0->Stamp=0;
+  for (i=0, s0->next=s0->prev=GetRef(s0);i < N_INDEXES;i++)
     while ( FreeList[i].next )
     {
       p=(RAR_MEM_BLK*)RemoveNode(i);
-      p->insertAt(&s0);
+      InsertBlock(p,s0);
       p->Stamp=0xFFFF;
       p->NU=Indx2Units[i];
     }
-  for (p=s0.next;p != &s0;p=p->next)
+  for (p=(RAR_MEM_BLK*)GetPtr(s0->next);p != s0;p=(RAR_MEM_BLK*)GetPtr(p->next))
     while ((p1=MBPtr(p,p->NU))->Stamp == 0xFFFF && int(p->NU)+p1->NU < 0x10000)
     {
-      p1->remove();
+      RemoveBlock(p1);
       p->NU += p1->NU;
     }
-  while ((p=s0.next) != &s0)
+  while ((p=(RAR_MEM_BLK*)GetPtr(s0->next)) != s0)
   {
-    for (p->remove(), sz=p->NU;sz > 128;sz -= 128, p=MBPtr(p,128))
+    for (RemoveBlock(p), sz=p->NU;sz > 128;sz -= 128, p=MBPtr(p,128))
       InsertNode(p,N_INDEXES-1);
     if (Indx2Units[i=Units2Indx[sz-1]] != sz)
     {
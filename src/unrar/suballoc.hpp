@@ -23,17 +23,7 @@ const int N_INDEXES=N1+N2+N3+N4;
 struct RAR_MEM_BLK 
 {
   ushort Stamp, NU;
-  RAR_MEM_BLK* next, * prev;
-  void insertAt(RAR_MEM_BLK* p) 
-  {
-    next=(prev=p)->next;
-    p->next=next->prev=this;
-  }
-  void remove() 
-  {
-    prev->next=next;
-    next->prev=prev;
-  }
+  uint32 next, prev; // Heap references, see SubAllocator::GetRef.
 } _PACK_ATTR;
 
 #ifndef STRICT_ALIGNMENT_REQUIRED
@@ -61,8 +51,11 @@ class SubAllocator
     inline void GlueFreeBlocks();
     void* AllocUnitsRare(int indx);
     inline RAR_MEM_BLK* MBPtr(RAR_MEM_BLK *BasePtr,int Items);
+    inline void InsertBlock(RAR_MEM_BLK *p,RAR_MEM_BLK *Prev);
+    inline void RemoveBlock(RAR_MEM_BLK *p);
 
     long SubAllocatorSize;
+    uint HeapSize; // Real size of HeapStart block, can exceed the needed.
     byte Indx2Units[N_INDEXES], Units2Indx[128], GlueCount;
     byte *HeapStart,*LoUnit, *HiUnit;
     struct RAR_NODE FreeList[N_INDEXES];
@@ -80,6 +73,15 @@ class SubAllocator
     inline void  FreeUnits(void* ptr,int OldNU);
     long GetAllocatedMemory() {return(SubAllocatorSize);};
 
+    // Model structures refer to each other with 32 bit offsets from
+    // HeapStart instead of pointers, so 64 bit builds keep the original
+    // 12 byte units and more of the model fits to CPU cache. Offset 0 is
+    // used as NULL, HeapStart itself is never referenced. NULL is mapped
+    // to HeapStart, which is not above pText, so the model validity
+    // checks against pText treat both in the same way.
+    uint32 GetRef(void *Ptr) {return (uint32)((byte *)Ptr-HeapStart);}
+    byte* GetPtr(uint32 Ref) {return HeapStart+Ref;}
+
     byte *pText, *UnitsStart,*HeapEnd,*FakeUnitsStart;
 };
 
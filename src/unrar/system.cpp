@@ -100,3 +100,25 @@ void Shutdown()
 #endif
 
 
+#ifdef USE_SSE
+SSE_VERSION _SSE_Version=GetSSEVersion();
+
+
+SSE_VERSION GetSSEVersion()
+{
+  // May be called from static initializers, before the compiler runtime
+  // has filled its CPU data.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return(SSE_AVX2);
+  if (__builtin_cpu_supports("sse4.1"))
+    return(SSE_SSE41);
+  if (__builtin_cpu_supports("ssse3"))
+    return(SSE_SSSE3);
+  if (__builtin_cpu_supports("sse2"))
+    return(SSE_SSE2);
+  if (__builtin_cpu_supports("sse"))
+    return(SSE_SSE);
+  return(SSE_NONE);
+}
+#endif
@@ -23,6 +23,12 @@ void Wait();
 bool EmailFile(char *FileName,char *MailTo);
 void Shutdown();
 
+#ifdef USE_SSE
+enum SSE_VERSION {SSE_NONE,SSE_SSE,SSE_SSE2,SSE_SSSE3,SSE_SSE41,SSE_AVX2};
+SSE_VERSION GetSSEVersion();
+extern SSE_VERSION _SSE_Version;
+#endif
+
 
 
 #endif
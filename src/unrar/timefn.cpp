@@ -64,7 +64,13 @@ void RarTime::GetWin32(FILETIME *ft)
 RarTime& RarTime::operator =(time_t ut)
 {
   struct tm *t;
+#ifdef _UNIX
+  // localtime returns a buffer shared by all threads.
+  struct tm lt;
+  t=localtime_r(&ut,&lt);
+#else
   t=localtime(&ut);
+#endif
 
   rlt.Year=t->tm_year+1900;
   rlt.Month=t->tm_mon+1;
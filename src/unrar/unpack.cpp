@@ -12,6 +12,10 @@ Unpack::Unpack(ComprDataIO *DataIO)
 {
   UnpIO=DataIO;
   Window=NULL;
+  MaxWinSize=0;
+  MaxWinMask=0;
+  WinAllocSize=0;
+  UnpPtr=WrPtr=0;
   Suspended=false;
   UnpAllBuf=false;
   UnpSomeRead=false;
@@ -20,23 +24,18 @@ Unpack::Unpack(ComprDataIO *DataIO)
 
 Unpack::~Unpack()
 {
-  delete[] Window;
+  free(Window);
   InitFilters();
 }
 
 
 void Unpack::Init()
 {
-  Window=new byte[MAXWINSIZE];
-
-#ifndef ALLOW_EXCEPTIONS
-  if (Window==NULL)
-    ErrHandler.MemoryError();
-#endif
-
-  // Clean the window to generate the same output when unpacking corrupt
-  // RAR files, which may access to unused areas of sliding dictionary.
-  memset(Window,0,MAXWINSIZE);
+  // Init can be called again to reuse the unpacker for another archive.
+  // The window allocation is kept, but its contents are discarded and
+  // SetWinSize clears as much of it as the next file needs.
+  MaxWinSize=0;
+  MaxWinMask=0;
 
   UnpInitData(false);
 
@@ -48,8 +47,56 @@ void Unpack::Init()
 }
 
 
+// Make the window large enough for the WinSize dictionary declared in
+// the file header. It only grows until the next Init, so files of a solid
+// stream can move to a larger dictionary.
+void Unpack::SetWinSize(uint WinSize)
+{
+  // Window pointers are masked, so the size must be a power of 2.
+  uint Size=0x10000;
+  while (Size<WinSize && Size<MAXWINSIZE)
+    Size*=2;
+  if (Size<=MaxWinSize)
+    return;
+
+  // Unpacked data stay at the same distance behind UnpPtr, so the part
+  // above UnpPtr, written before the last wraparound, moves to the end.
+  // The area in between is cleared to generate the same output when
+  // unpacking corrupt RAR files, which may access to unused areas of
+  // sliding dictionary.
+  uint Grow=Size-MaxWinSize;
+  uint Ptr=MaxWinSize==0 ? 0:UnpPtr;
+  if (Size>WinAllocSize)
+  {
+    // calloc memory is already clean, often without touching its pages.
+    byte *NewWindow=(byte *)calloc(Size,1);
+    if (NewWindow==NULL)
+      ErrHandler.MemoryError();
+    if (MaxWinSize>0)
+    {
+      memcpy(NewWindow,Window,Ptr);
+      memcpy(NewWindow+Ptr+Grow,Window+Ptr,MaxWinSize-Ptr);
+    }
+    free(Window);
+    Window=NewWindow;
+    WinAllocSize=Size;
+  }
+  else
+  {
+    memmove(Window+Ptr+Grow,Window+Ptr,MaxWinSize-Ptr);
+    memset(Window+Ptr,0,Grow);
+  }
+  MaxWinSize=Size;
+  MaxWinMask=Size-1;
+}
+
+
 void Unpack::DoUnpack(int Method,bool Solid)
 {
+  // RAR 3.x filters can process blocks up to VM_MEMSIZE, which must fit
+  // to window along with data decoded after them whatever the dictionary.
+  SetWinSize(Method==29 || Method==36 ? 2*VM_MEMSIZE:0x10000);
+
   switch(Method)
   {
 #ifndef SFX_MODULE
@@ -81,10 +128,10 @@ inline void Unpack::InsertOldDist(unsigned int Distance)
 _forceinline void Unpack::CopyString(uint Length,uint Distance)
 {
   uint SrcPtr=UnpPtr-Distance;
-  if (SrcPtr<MAXWINSIZE-MAX_LZ_MATCH && UnpPtr<MAXWINSIZE-MAX_LZ_MATCH)
+  if (SrcPtr<MaxWinSize-MAX_LZ_MATCH && UnpPtr<MaxWinSize-MAX_LZ_MATCH)
   {
     // If we are not close to end of window, we do not need to waste time
-    // to "& MAXWINMASK" pointer protection.
+    // to "& MaxWinMask" pointer protection.
 
     byte *Src=Window+SrcPtr;
     byte *Dest=Window+UnpPtr;
@@ -118,21 +165,23 @@ _forceinline void Unpack::CopyString(uint Length,uint Distance)
   else
     while (Length--) // Slow copying with all possible precautions.
     {
-      Window[UnpPtr]=Window[SrcPtr++ & MAXWINMASK];
-      UnpPtr=(UnpPtr+1) & MAXWINMASK;
+      Window[UnpPtr]=Window[SrcPtr++ & MaxWinMask];
+      UnpPtr=(UnpPtr+1) & MaxWinMask;
     }
 }
 
 
-_forceinline uint Unpack::DecodeNumber(DecodeTable *Dec)
+// Decode the left aligned bit field to an alphabet number and store
+// the length of its code to Length.
+static _forceinline uint DecodeBitField(DecodeTable *Dec,uint BitField,uint &Length)
 {
   // Left aligned 15 bit length raw bit field.
-  uint BitField=getbits() & 0xfffe;
+  BitField&=0xfffe;
 
   if (BitField<Dec->DecodeLen[Dec->QuickBits])
   {
     uint Code=BitField>>(16-Dec->QuickBits);
-    addbits(Dec->QuickLen[Code]);
+    Length=Dec->QuickLen[Code];
     return Dec->QuickNum[Code];
   }
 
@@ -145,7 +194,7 @@ _forceinline uint Unpack::DecodeNumber(DecodeTable *Dec)
       break;
     }
 
-  addbits(Bits);
+  Length=Bits;
   
   // Calculate the distance from the start code for current bit length.
   uint Dist=BitField-Dec->DecodeLen[Bits-1];
@@ -169,6 +218,15 @@ _forceinline uint Unpack::DecodeNumber(DecodeTable *Dec)
 }
 
 
+_forceinline uint Unpack::DecodeNumber(DecodeTable *Dec)
+{
+  uint Length;
+  uint Number=DecodeBitField(Dec,getbits(),Length);
+  addbits(Length);
+  return(Number);
+}
+
+
 // We use it instead of direct PPM.DecodeChar call to be sure that
 // we reset PPM structures in case of corrupt data. It is important,
 // because these structures can be invalid after PPM.DecodeChar returned -1.
@@ -184,19 +242,17 @@ inline int Unpack::SafePPMDecodeChar()
 }
 
 
-void Unpack::Unpack29(bool Solid)
-{
-  static unsigned char LDecode[]={0,1,2,3,4,5,6,7,8,10,12,14,16,20,24,28,32,40,48,56,64,80,96,112,128,160,192,224};
-  static unsigned char LBits[]=  {0,0,0,0,0,0,0,0,1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5};
-  static int DDecode[DC];
-  static byte DBits[DC];
-  static int DBitLengthCounts[]= {4,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,14,0,12};
-  static unsigned char SDDecode[]={0,4,8,16,32,64,128,192};
-  static unsigned char SDBits[]=  {2,2,3, 4, 5, 6,  6,  6};
-  unsigned int Bits;
+// Distance slots for Unpack29. They are shared by all unpackers, so build
+// them at startup rather than on the first call, when another thread could
+// already be decoding with a half filled table.
+static int DDecode[DC];
+static byte DBits[DC];
 
-  if (DDecode[1]==0)
+static struct InitDDecode
+{
+  InitDDecode()
   {
+    static int DBitLengthCounts[]= {4,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,14,0,12};
     int Dist=0,BitLength=0,Slot=0;
     for (int I=0;I<ASIZE(DBitLengthCounts);I++,BitLength++)
       for (int J=0;J<DBitLengthCounts[I];J++,Slot++,Dist+=(1<<BitLength))
@@ -205,6 +261,232 @@ void Unpack::Unpack29(bool Solid)
         DBits[Slot]=BitLength;
       }
   }
+} InitDDecodeTables;
+
+
+static unsigned char LDecode[]={0,1,2,3,4,5,6,7,8,10,12,14,16,20,24,28,32,40,48,56,64,80,96,112,128,160,192,224};
+static unsigned char LBits[]=  {0,0,0,0,0,0,0,0,1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5};
+static unsigned char SDDecode[]={0,4,8,16,32,64,128,192};
+static unsigned char SDBits[]=  {2,2,3, 4, 5, 6,  6,  6};
+
+// Longest string a single RAR 3.x LZ symbol can produce, including
+// the length bonus for long distances.
+#define MAX_LZ29_SYMBOL (MAX_LZ_MATCH+3)
+
+
+// 64 bits starting from p, first byte highest.
+static _forceinline uint64 GetBE64(const byte *p)
+{
+#if defined(LITTLE_ENDIAN) && defined(__GNUC__)
+  uint64 v;
+  memcpy(&v,p,sizeof(v));
+  return(__builtin_bswap64(v));
+#else
+  return(((uint64)p[0]<<56)|((uint64)p[1]<<48)|((uint64)p[2]<<40)|((uint64)p[3]<<32)|
+         ((uint64)p[4]<<24)|((uint64)p[5]<<16)|((uint64)p[6]<<8)|(uint64)p[7]);
+#endif
+}
+
+
+// Top up the bit accumulator to 56-63 bits with a single load. BitBuf
+// holds BitCount bits from the input left aligned, followed by a few
+// more which the next load puts at the same place again.
+static _forceinline void RefillBits(uint64 &BitBuf,uint &BitCount,const byte *&InPtr)
+{
+  BitBuf|=GetBE64(InPtr)>>BitCount;
+  InPtr+=(63-BitCount)>>3;
+  BitCount|=56;
+}
+
+
+// Decode RAR 3.x LZ symbols for as long as the window and the input
+// buffer have room for them, without the checks Unpack29 makes for every
+// symbol. Bits come from a 64 bit accumulator refilled once per symbol,
+// and the accumulator and window position are held in locals, because
+// the compiler must reload members after every byte stored to the window.
+// Stops in front of block end, filter and last length symbols and leaves
+// them to Unpack29. Returns false if nothing was decoded.
+bool Unpack::DecodeLZ29()
+{
+  // Room in the window before the unwritten data or the end of window.
+  uint WinSize=MaxWinSize,WinMask=MaxWinMask;
+  uint Free=WrPtr==UnpPtr ? WinSize:((WrPtr-UnpPtr)&WinMask);
+  uint Room=Min(Free,WinSize-UnpPtr);
+  if (Room<=MAX_LZ29_SYMBOL || InAddr>ReadBorder)
+    return(false);
+
+  // Symbols must start below WinBorder, so even the longest of them
+  // keeps at least one byte of room.
+  uint WinBorder=UnpPtr+Room-MAX_LZ29_SYMBOL;
+  byte *Win=Window;
+  uint Ptr=UnpPtr;
+
+  const byte *InPtr=InBuf+InAddr;
+  uint64 BitBuf=0;
+  uint BitCount=0;
+  RefillBits(BitBuf,BitCount,InPtr);
+  BitBuf<<=InBit;
+  BitCount-=InBit;
+
+  while (Ptr<WinBorder && (int)(InPtr-InBuf)<=ReadBorder)
+  {
+    // Enough bits for a complete symbol except for the low distance code,
+    // which gets another refill.
+    RefillBits(BitBuf,BitCount,InPtr);
+    uint Length,CodeLength,Bits;
+
+    uint Number=DecodeBitField(&LD,(uint)(BitBuf>>48),CodeLength);
+    if (Number<256)
+    {
+      Win[Ptr++]=(byte)Number;
+      BitBuf<<=CodeLength;
+      BitCount-=CodeLength;
+      continue;
+    }
+    if (Number<=258)
+      break;
+    BitBuf<<=CodeLength;
+    BitCount-=CodeLength;
+
+    uint Distance;
+    if (Number>=271)
+    {
+      Number-=271;
+      Length=LDecode[Number]+3;
+      if ((Bits=LBits[Number])>0)
+      {
+        Length+=(uint)(BitBuf>>(64-Bits));
+        BitBuf<<=Bits;
+        BitCount-=Bits;
+      }
+
+      uint DistNumber=DecodeBitField(&DD,(uint)(BitBuf>>48),CodeLength);
+      BitBuf<<=CodeLength;
+      BitCount-=CodeLength;
+      Distance=DDecode[DistNumber]+1;
+      if ((Bits=DBits[DistNumber])>0)
+      {
+        if (DistNumber>9)
+        {
+          if (Bits>4)
+          {
+            Distance+=(uint)(BitBuf>>(68-Bits))<<4;
+            BitBuf<<=Bits-4;
+            BitCount-=Bits-4;
+          }
+          if (LowDistRepCount>0)
+          {
+            LowDistRepCount--;
+            Distance+=PrevLowDist;
+          }
+          else
+          {
+            RefillBits(BitBuf,BitCount,InPtr);
+            uint LowDist=DecodeBitField(&LDD,(uint)(BitBuf>>48),CodeLength);
+            BitBuf<<=CodeLength;
+            BitCount-=CodeLength;
+            if (LowDist==16)
+            {
+              LowDistRepCount=LOW_DIST_REP_COUNT-1;
+              Distance+=PrevLowDist;
+            }
+            else
+            {
+              Distance+=LowDist;
+              PrevLowDist=LowDist;
+            }
+          }
+        }
+        else
+        {
+          Distance+=(uint)(BitBuf>>(64-Bits));
+          BitBuf<<=Bits;
+          BitCount-=Bits;
+        }
+      }
+
+      if (Distance>=0x2000)
+      {
+        Length++;
+        if (Distance>=0x40000L)
+          Length++;
+      }
+      InsertOldDist(Distance);
+    }
+    else
+      if (Number<263)
+      {
+        uint DistNum=Number-259;
+        Distance=OldDist[DistNum];
+        for (uint I=DistNum;I>0;I--)
+          OldDist[I]=OldDist[I-1];
+        OldDist[0]=Distance;
+
+        uint LengthNumber=DecodeBitField(&RD,(uint)(BitBuf>>48),CodeLength);
+        BitBuf<<=CodeLength;
+        BitCount-=CodeLength;
+        Length=LDecode[LengthNumber]+2;
+        if ((Bits=LBits[LengthNumber])>0)
+        {
+          Length+=(uint)(BitBuf>>(64-Bits));
+          BitBuf<<=Bits;
+          BitCount-=Bits;
+        }
+      }
+      else
+      {
+        Number-=263;
+        Distance=SDDecode[Number]+1;
+        if ((Bits=SDBits[Number])>0)
+        {
+          Distance+=(uint)(BitBuf>>(64-Bits));
+          BitBuf<<=Bits;
+          BitCount-=Bits;
+        }
+        InsertOldDist(Distance);
+        Length=2;
+      }
+    LastLength=Length;
+
+    // Copy the string. The window has room for it at Ptr, but the source
+    // can wrap around the end of window.
+    uint SrcPtr=(Ptr-Distance)&WinMask;
+    byte *Dest=Win+Ptr;
+    Ptr+=Length;
+    if (SrcPtr<WinSize-MAX_LZ29_SYMBOL)
+    {
+      byte *Src=Win+SrcPtr;
+
+      // 8 byte moves are safe unless the source is less than 8 bytes
+      // behind, when bytes just copied must be copied again.
+      if (Dest-Src>=8 || Src>Dest)
+        for (;Length>=8;Length-=8,Src+=8,Dest+=8)
+        {
+          uint64 Data;
+          memcpy(&Data,Src,sizeof(Data));
+          memcpy(Dest,&Data,sizeof(Data));
+        }
+      for (uint I=0;I<Length;I++)
+        Dest[I]=Src[I];
+    }
+    else
+      for (uint I=0;I<Length;I++)
+        Dest[I]=Win[(SrcPtr+I)&WinMask];
+  }
+
+  // Bits left in the accumulator are given back to the input.
+  uint BitPos=(uint)(InPtr-InBuf)*8-BitCount;
+  bool Decoded=Ptr!=UnpPtr;
+  UnpPtr=Ptr;
+  InAddr=BitPos>>3;
+  InBit=BitPos&7;
+  return(Decoded);
+}
+
+
+void Unpack::Unpack29(bool Solid)
+{
+  unsigned int Bits;
 
   FileExtracted=true;
 
@@ -219,14 +501,14 @@ void Unpack::Unpack29(bool Solid)
 
   while (true)
   {
-    UnpPtr&=MAXWINMASK;
+    UnpPtr&=MaxWinMask;
 
     if (InAddr>ReadBorder)
     {
       if (!UnpReadBuf())
         break;
     }
-    if (((WrPtr-UnpPtr) & MAXWINMASK)<260 && WrPtr!=UnpPtr)
+    if (((WrPtr-UnpPtr) & MaxWinMask)<260 && WrPtr!=UnpPtr)
     {
       UnpWriteBuf();
       if (WrittenFileSize>DestUnpSize)
@@ -304,6 +586,9 @@ void Unpack::Unpack29(bool Solid)
       continue;
     }
 
+    if (DecodeLZ29())
+      continue;
+
     int Number=DecodeNumber(&LD);
     if (Number<256)
     {
@@ -599,7 +884,7 @@ bool Unpack::AddVMCode(unsigned int FirstByte,byte *Code,int CodeSize)
   uint BlockStart=RarVM::ReadData(VMCodeInp);
   if (FirstByte & 0x40)
     BlockStart+=258;
-  StackFilter->BlockStart=(BlockStart+UnpPtr)&MAXWINMASK;
+  StackFilter->BlockStart=(BlockStart+UnpPtr)&MaxWinMask;
   if (FirstByte & 0x20)
   {
     StackFilter->BlockLength=RarVM::ReadData(VMCodeInp);
@@ -616,7 +901,7 @@ bool Unpack::AddVMCode(unsigned int FirstByte,byte *Code,int CodeSize)
     StackFilter->BlockLength=FiltPos<OldFilterLengths.Size() ? OldFilterLengths[FiltPos]:0;
   }
 
-  StackFilter->NextWindow=WrPtr!=UnpPtr && ((WrPtr-UnpPtr)&MAXWINMASK)<=BlockStart;
+  StackFilter->NextWindow=WrPtr!=UnpPtr && ((WrPtr-UnpPtr)&MaxWinMask)<=BlockStart;
 
 //  DebugLog("\nNextWindow: UnpPtr=%08x WrPtr=%08x BlockStart=%08x",UnpPtr,WrPtr,BlockStart);
 
@@ -651,6 +936,7 @@ bool Unpack::AddVMCode(unsigned int FirstByte,byte *Code,int CodeSize)
   }
   StackFilter->Prg.AltCmd=&Filter->Prg.Cmd[0];
   StackFilter->Prg.CmdCount=Filter->Prg.CmdCount;
+  StackFilter->Prg.Type=Filter->Prg.Type;
 
   size_t StaticDataSize=Filter->Prg.StaticData.Size();
   if (StaticDataSize>0 && StaticDataSize<VM_GLOBALMEMSIZE)
@@ -723,7 +1009,7 @@ bool Unpack::UnpReadBuf()
 void Unpack::UnpWriteBuf()
 {
   unsigned int WrittenBorder=WrPtr;
-  unsigned int WriteSize=(UnpPtr-WrittenBorder)&MAXWINMASK;
+  unsigned int WriteSize=(UnpPtr-WrittenBorder)&MaxWinMask;
   for (size_t I=0;I<PrgStack.Size();I++)
   {
     // Here we apply filters to data which we need to write.
@@ -742,47 +1028,57 @@ void Unpack::UnpWriteBuf()
     }
     unsigned int BlockStart=flt->BlockStart;
     unsigned int BlockLength=flt->BlockLength;
-    if (((BlockStart-WrittenBorder)&MAXWINMASK)<WriteSize)
+    if (((BlockStart-WrittenBorder)&MaxWinMask)<WriteSize)
     {
       if (WrittenBorder!=BlockStart)
       {
         UnpWriteArea(WrittenBorder,BlockStart);
         WrittenBorder=BlockStart;
-        WriteSize=(UnpPtr-WrittenBorder)&MAXWINMASK;
+        WriteSize=(UnpPtr-WrittenBorder)&MaxWinMask;
       }
       if (BlockLength<=WriteSize)
       {
-        unsigned int BlockEnd=(BlockStart+BlockLength)&MAXWINMASK;
-        if (BlockStart<BlockEnd || BlockEnd==0)
-          VM.SetMemory(0,Window+BlockStart,BlockLength);
-        else
-        {
-          unsigned int FirstPartLength=MAXWINSIZE-BlockStart;
-          VM.SetMemory(0,Window+BlockStart,FirstPartLength);
-          VM.SetMemory(FirstPartLength,Window,BlockEnd);
-        }
-
+        unsigned int BlockEnd=(BlockStart+BlockLength)&MaxWinMask;
         VM_PreparedProgram *ParentPrg=&Filters[flt->ParentFilter]->Prg;
         VM_PreparedProgram *Prg=&flt->Prg;
 
-        if (ParentPrg->GlobalData.Size()>VM_FIXEDGLOBALSIZE)
+        if ((BlockStart<BlockEnd || BlockEnd==0) &&
+            ExecuteStandardCode(Prg,Window+BlockStart,BlockLength))
         {
-          // Copy global data from previous script execution if any.
-          Prg->GlobalData.Alloc(ParentPrg->GlobalData.Size());
-          memcpy(&Prg->GlobalData[VM_FIXEDGLOBALSIZE],&ParentPrg->GlobalData[VM_FIXEDGLOBALSIZE],ParentPrg->GlobalData.Size()-VM_FIXEDGLOBALSIZE);
+          // Standard filters do not store any global data, so VM would
+          // discard it too.
+          ParentPrg->GlobalData.Reset();
         }
+        else
+        {
+          if (BlockStart<BlockEnd || BlockEnd==0)
+            VM.SetMemory(0,Window+BlockStart,BlockLength);
+          else
+          {
+            unsigned int FirstPartLength=MaxWinSize-BlockStart;
+            VM.SetMemory(0,Window+BlockStart,FirstPartLength);
+            VM.SetMemory(FirstPartLength,Window,BlockEnd);
+          }
 
-        ExecuteCode(Prg);
+          if (ParentPrg->GlobalData.Size()>VM_FIXEDGLOBALSIZE)
+          {
+            // Copy global data from previous script execution if any.
+            Prg->GlobalData.Alloc(ParentPrg->GlobalData.Size());
+            memcpy(&Prg->GlobalData[VM_FIXEDGLOBALSIZE],&ParentPrg->GlobalData[VM_FIXEDGLOBALSIZE],ParentPrg->GlobalData.Size()-VM_FIXEDGLOBALSIZE);
+          }
 
-        if (Prg->GlobalData.Size()>VM_FIXEDGLOBALSIZE)
-        {
-          // Save global data for next script execution.
-          if (ParentPrg->GlobalData.Size()<Prg->GlobalData.Size())
-            ParentPrg->GlobalData.Alloc(Prg->GlobalData.Size());
-          memcpy(&ParentPrg->GlobalData[VM_FIXEDGLOBALSIZE],&Prg->GlobalData[VM_FIXEDGLOBALSIZE],Prg->GlobalData.Size()-VM_FIXEDGLOBALSIZE);
+          ExecuteCode(Prg);
+
+          if (Prg->GlobalData.Size()>VM_FIXEDGLOBALSIZE)
+          {
+            // Save global data for next script execution.
+            if (ParentPrg->GlobalData.Size()<Prg->GlobalData.Size())
+              ParentPrg->GlobalData.Alloc(Prg->GlobalData.Size());
+            memcpy(&ParentPrg->GlobalData[VM_FIXEDGLOBALSIZE],&Prg->GlobalData[VM_FIXEDGLOBALSIZE],Prg->GlobalData.Size()-VM_FIXEDGLOBALSIZE);
+          }
+          else
+            ParentPrg->GlobalData.Reset();
         }
-        else
-          ParentPrg->GlobalData.Reset();
 
         byte *FilteredData=Prg->FilteredData;
         unsigned int FilteredDataSize=Prg->FilteredDataSize;
@@ -832,7 +1128,7 @@ void Unpack::UnpWriteBuf()
         UnpSomeRead=true;
         WrittenFileSize+=FilteredDataSize;
         WrittenBorder=BlockEnd;
-        WriteSize=(UnpPtr-WrittenBorder)&MAXWINMASK;
+        WriteSize=(UnpPtr-WrittenBorder)&MaxWinMask;
       }
       else
       {
@@ -867,13 +1163,36 @@ void Unpack::ExecuteCode(VM_PreparedProgram *Prg)
 }
 
 
+// Apply a standard filter to continuous window data without copying
+// it to VM memory first. The result is placed to FilterDstMemory.
+// Returns false if the filter must be executed by VM.
+bool Unpack::ExecuteStandardCode(VM_PreparedProgram *Prg,byte *Data,uint DataSize)
+{
+#ifdef VM_STANDARDFILTERS
+  if (Prg->Type==VMSF_NONE || DataSize==0)
+    return(false);
+  if (FilterDstMemory.Size()<DataSize)
+    FilterDstMemory.Alloc(DataSize);
+  if (!VM.ApplyStandardFilter(Prg->Type,Prg->InitR,Data,&FilterDstMemory[0],
+                              DataSize,(uint)WrittenFileSize))
+    return(false);
+  Prg->FilteredData=&FilterDstMemory[0];
+  Prg->FilteredDataSize=DataSize;
+  Prg->GlobalData.Reset();
+  return(true);
+#else
+  return(false);
+#endif
+}
+
+
 void Unpack::UnpWriteArea(unsigned int StartPtr,unsigned int EndPtr)
 {
   if (EndPtr!=StartPtr)
     UnpSomeRead=true;
   if (EndPtr<StartPtr)
   {
-    UnpWriteData(&Window[StartPtr],-(int)StartPtr & MAXWINMASK);
+    UnpWriteData(&Window[StartPtr],-(int)StartPtr & MaxWinMask);
     UnpWriteData(Window,EndPtr);
     UnpAllBuf=true;
   }
@@ -1010,7 +1329,7 @@ void Unpack::UnpInitData(int Solid)
     memset(OldDist,0,sizeof(OldDist));
     OldDistPtr=0;
     LastDist=LastLength=0;
-//    memset(Window,0,MAXWINSIZE);
+//    memset(Window,0,MaxWinSize);
     memset(UnpOldTable,0,sizeof(UnpOldTable));
     memset(&LD,0,sizeof(LD));
     memset(&DD,0,sizeof(DD));
@@ -82,9 +82,11 @@ class Unpack:private BitInput
   private:
 
     void Unpack29(bool Solid);
+    bool DecodeLZ29();
     bool UnpReadBuf();
     void UnpWriteBuf();
     void ExecuteCode(VM_PreparedProgram *Prg);
+    bool ExecuteStandardCode(VM_PreparedProgram *Prg,byte *Data,uint DataSize);
     void UnpWriteArea(unsigned int StartPtr,unsigned int EndPtr);
     void UnpWriteData(byte *Data,size_t Size);
     bool ReadTables();
@@ -123,6 +125,9 @@ class Unpack:private BitInput
     // the data block length if lengths are repeating.
     Array<int> OldFilterLengths;
 
+    // Output of standard filters applied directly to window data.
+    Array<byte> FilterDstMemory;
+
     int LastFilter;
 
     bool TablesRead;
@@ -156,6 +161,13 @@ class Unpack:private BitInput
 
     byte *Window;
 
+    // Window size used by the current file and its pointer mask. Both
+    // are powers of 2 no larger than MAXWINSIZE. The allocation can be
+    // larger if it was kept from a previous archive.
+    uint MaxWinSize;
+    uint MaxWinMask;
+    uint WinAllocSize;
+
 
     int64 DestUnpSize;
 
@@ -206,6 +218,7 @@ class Unpack:private BitInput
     Unpack(ComprDataIO *DataIO);
     ~Unpack();
     void Init();
+    void SetWinSize(uint WinSize);
     void DoUnpack(int Method,bool Solid);
     bool IsFileExtracted() {return(FileExtracted);}
     void SetDestSize(int64 DestSize) {DestUnpSize=DestSize;FileExtracted=false;}
@@ -63,11 +63,11 @@ void Unpack::Unpack15(bool Solid)
 
   while (DestUnpSize>=0)
   {
-    UnpPtr&=MAXWINMASK;
+    UnpPtr&=MaxWinMask;
 
     if (InAddr>ReadTop-30 && !UnpReadBuf())
       break;
-    if (((WrPtr-UnpPtr) & MAXWINMASK)<270 && WrPtr!=UnpPtr)
+    if (((WrPtr-UnpPtr) & MaxWinMask)<270 && WrPtr!=UnpPtr)
     {
       OldUnpWriteBuf();
       if (Suspended)
@@ -126,7 +126,7 @@ void Unpack::OldUnpWriteBuf()
     UnpSomeRead=true;
   if (UnpPtr<WrPtr)
   {
-    UnpIO->UnpWrite(&Window[WrPtr],-(int)WrPtr & MAXWINMASK);
+    UnpIO->UnpWrite(&Window[WrPtr],-(int)WrPtr & MaxWinMask);
     UnpIO->UnpWrite(Window,UnpPtr);
     UnpAllBuf=true;
   }
@@ -490,8 +490,8 @@ void Unpack::OldCopyString(unsigned int Distance,unsigned int Length)
   DestUnpSize-=Length;
   while (Length--)
   {
-    Window[UnpPtr]=Window[(UnpPtr-Distance) & MAXWINMASK];
-    UnpPtr=(UnpPtr+1) & MAXWINMASK;
+    Window[UnpPtr]=Window[(UnpPtr-Distance) & MaxWinMask];
+    UnpPtr=(UnpPtr+1) & MaxWinMask;
   }
 }
 
@@ -7,7 +7,7 @@ void Unpack::CopyString20(unsigned int Length,unsigned int Distance)
   DestUnpSize-=Length;
 
   unsigned int DestPtr=UnpPtr-Distance;
-  if (DestPtr<MAXWINSIZE-300 && UnpPtr<MAXWINSIZE-300)
+  if (DestPtr<MaxWinSize-300 && UnpPtr<MaxWinSize-300)
   {
     Window[UnpPtr++]=Window[DestPtr++];
     Window[UnpPtr++]=Window[DestPtr++];
@@ -20,8 +20,8 @@ void Unpack::CopyString20(unsigned int Length,unsigned int Distance)
   else
     while (Length--)
     {
-      Window[UnpPtr]=Window[DestPtr++ & MAXWINMASK];
-      UnpPtr=(UnpPtr+1) & MAXWINMASK;
+      Window[UnpPtr]=Window[DestPtr++ & MaxWinMask];
+      UnpPtr=(UnpPtr+1) & MaxWinMask;
     }
 }
 
@@ -51,12 +51,12 @@ void Unpack::Unpack20(bool Solid)
 
   while (DestUnpSize>=0)
   {
-    UnpPtr&=MAXWINMASK;
+    UnpPtr&=MaxWinMask;
 
     if (InAddr>ReadTop-30)
       if (!UnpReadBuf())
         break;
-    if (((WrPtr-UnpPtr) & MAXWINMASK)<270 && WrPtr!=UnpPtr)
+    if (((WrPtr-UnpPtr) & MaxWinMask)<270 && WrPtr!=UnpPtr)
     {
       OldUnpWriteBuf();
       if (Suspended)
@@ -41,7 +41,7 @@ bool MergeArchive(Archive &Arc,ComprDataIO *DataIO,bool ShowFileName,char Comman
 #if !defined(SFX_MODULE) && !defined(RARDLL)
   bool RecoveryDone=false;
 #endif
-  bool FailedOpen=false,OldSchemeTested=false;
+  bool FailedOpen=false,OldSchemeTested=false,Prefetched=false;
 
 #if !defined(GUI) && !defined(SILENT)
   // In -vp mode we force the pause before next volume even if it is present
@@ -51,7 +51,12 @@ bool MergeArchive(Archive &Arc,ComprDataIO *DataIO,bool ShowFileName,char Comman
     FailedOpen=true;
 #endif
 
-  if (!FailedOpen)
+#ifdef RARDLL
+  if (!FailedOpen && Cmd->VolPrefetch!=NULL)
+    Prefetched=Cmd->VolPrefetch->Take(Arc,NextName,NextNameW);
+#endif
+
+  if (!FailedOpen && !Prefetched)
     while (!Arc.Open(NextName,NextNameW,0))
     {
       // We need to open a new volume which size was not calculated
@@ -199,6 +204,8 @@ bool MergeArchive(Archive &Arc,ComprDataIO *DataIO,bool ShowFileName,char Comman
     if (RetCode==0)
       return(false);
   }
+  if (Cmd->VolPrefetch!=NULL)
+    Cmd->VolPrefetch->Start(Arc);
 #endif
 
   if (Command=='T' || Command=='X' || Command=='E')
@@ -269,6 +276,90 @@ bool MergeArchive(Archive &Arc,ComprDataIO *DataIO,bool ShowFileName,char Comman
 
 
 
+VolumePrefetch::VolumePrefetch()
+{
+  Running=false;
+  FillBuf=0;
+  DataSize=0;
+  *VolName=0;
+  *VolNameW=0;
+  Vol.SetExceptions(false);
+}
+
+
+VolumePrefetch::~VolumePrefetch()
+{
+  Stop();
+}
+
+
+// Begin reading the volume following Arc. The buffer Arc reads ahead
+// from may be one of ours, so the other one is filled.
+void VolumePrefetch::Start(Archive &Arc)
+{
+  Stop();
+#ifdef _UNIX
+  strcpy(VolName,Arc.FileName);
+  wcscpy(VolNameW,Arc.FileNameW);
+  NextVolumeName(VolName,VolNameW,ASIZE(VolName),(Arc.NewMhd.Flags & MHD_NEWNUMBERING)==0 || Arc.OldFormat);
+  FillBuf=Arc.GetReadAhead()==Buf[0].Addr() ? 1:0;
+  Buf[FillBuf].Alloc(PREFETCH_SIZE);
+  DataSize=0;
+  Running=pthread_create(&Thread,NULL,PrefetchThread,this)==0;
+#endif
+}
+
+
+#ifdef _UNIX
+void* VolumePrefetch::PrefetchThread(void *Data)
+{
+  VolumePrefetch *Pf=(VolumePrefetch *)Data;
+  if (Pf->Vol.Open(Pf->VolName,Pf->VolNameW))
+    while (Pf->DataSize<PREFETCH_SIZE)
+    {
+      int ReadSize=Pf->Vol.DirectRead(&Pf->Buf[Pf->FillBuf][Pf->DataSize],PREFETCH_SIZE-Pf->DataSize);
+      if (ReadSize==-1)
+        Pf->Vol.Close(); // Let MergeArchive open it and report the error.
+      if (ReadSize<=0)
+        break;
+      Pf->DataSize+=ReadSize;
+    }
+  return(NULL);
+}
+#endif
+
+
+// Hand the prefetched volume over to Arc if it is the one named.
+bool VolumePrefetch::Take(Archive &Arc,const char *Name,const wchar *NameW)
+{
+  if (!Running)
+    return(false);
+#ifdef _UNIX
+  pthread_join(Thread,NULL);
+#endif
+  Running=false;
+  if (!Vol.IsOpened() || strcmp(Name,VolName)!=0 || wcscmp(NullToEmpty(NameW),VolNameW)!=0)
+  {
+    Vol.Close();
+    return(false);
+  }
+  Arc.TakeHandle(Vol,Buf[FillBuf].Addr(),PREFETCH_SIZE,DataSize);
+  return(true);
+}
+
+
+// Wait for the background read and drop whatever it opened.
+void VolumePrefetch::Stop()
+{
+#ifdef _UNIX
+  if (Running)
+    pthread_join(Thread,NULL);
+#endif
+  Running=false;
+  Vol.Close();
+}
+
+
 #ifndef SILENT
 bool AskNextVol(char *ArcName,wchar *ArcNameW)
 {
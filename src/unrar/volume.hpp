@@ -8,4 +8,32 @@ bool MergeArchive(Archive &Arc,ComprDataIO *DataIO,bool ShowFileName,
 void SetVolWrite(Archive &Dest,int64 VolSize);
 bool AskNextVol(char *ArcName,wchar *ArcNameW);
 
+// Opens the next volume and reads its first PREFETCH_SIZE bytes on
+// a background thread while the current volume is being processed, so
+// MergeArchive can take over a ready handle and buffer. Only one volume
+// is prefetched at a time.
+class VolumePrefetch
+{
+  private:
+    static const size_t PREFETCH_SIZE=0x100000;
+
+#ifdef _UNIX
+    static void* PrefetchThread(void *Data);
+    pthread_t Thread;
+#endif
+    bool Running;
+    File Vol;
+    char VolName[NM];
+    wchar VolNameW[NM];
+    Array<byte> Buf[2];
+    int FillBuf;     // Buffer being filled for VolName.
+    size_t DataSize; // Bytes of VolName read into it.
+  public:
+    VolumePrefetch();
+    ~VolumePrefetch();
+    void Start(Archive &Arc);
+    bool Take(Archive &Arc,const char *Name,const wchar *NameW);
+    void Stop();
+};
+
 #endif
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "fileset.h"
+
+/*
+ * Deep verification of zip members.  The central directory only tells us
+ * what the CRCs should be, so every member is inflated into a sink that
+ * just keeps a running CRC.  The archive is mapped once and each thread
+ * gets its own reader over the mapping, picking members off a shared
+ * counter.  Members up to ZIPCHECK_WHOLE_MAX are inflated whole into a
+ * per-thread buffer instead, which lets tinfl take its fast path.
+ */
+#define ZIPCHECK_MAX_THREADS	64
+#define ZIPCHECK_WHOLE_MAX	(64 * 1024 * 1024)
+
+struct zipcheck_job {
+	char		*path;
+	const void	*map;
+	size_t		size;
+	mz_uint		nfiles;
+	mz_uint		next;
+	int		bad;
+	int		mode;
+	pthread_mutex_t	lock;
+};
+
+struct zipcheck_sink {
+	mz_ulong	crc;
+	mz_uint64	size;
+};
+
+static size_t
+zipcheck_sink(void *opaque, mz_uint64 ofs, const void *buf, size_t n)
+{
+	struct zipcheck_sink *sink = (struct zipcheck_sink *)opaque;
+
+	sink->crc = mz_crc32(sink->crc, (const mz_uint8 *)buf, n);
+	sink->size += n;
+
+	return n;
+}
+
+/*
+ * Inflate member i and check it against zsb.  Members small enough are
+ * inflated whole into *buf, grown as needed, and checked by miniz itself;
+ * the rest, and any member that fails, go through the CRC sink so a
+ * failure can report what the CRC actually came out as.
+ */
+static int
+zipcheck_member(mz_zip_archive *zip, mz_uint i, mz_zip_archive_file_stat *zsb, void **buf, size_t *bufsize, mz_ulong *crc)
+{
+	struct zipcheck_sink	sink = {MZ_CRC32_INIT, 0};
+	int			ok;
+
+	if (zsb->m_uncomp_size <= ZIPCHECK_WHOLE_MAX) {
+		if (zsb->m_uncomp_size > *bufsize) {
+			free(*buf);
+			*bufsize = zsb->m_uncomp_size;
+			if ((*buf = malloc(*bufsize)) == NULL) {
+				*bufsize = 0;
+			}
+		}
+		if ((zsb->m_uncomp_size == 0 || *buf != NULL) &&
+		    mz_zip_reader_extract_to_mem_no_alloc(zip, i, *buf, *bufsize, 0, NULL, 0)) {
+			*crc = zsb->m_crc32;
+			return 1;
+		}
+	}
+
+	ok = mz_zip_reader_extract_to_callback(zip, i, zipcheck_sink, &sink, 0);
+	*crc = sink.crc;
+
+	return ok && sink.crc == zsb->m_crc32 && sink.size == zsb->m_uncomp_size;
+}
+
+static void *
+zipcheck_worker(void *arg)
+{
+	struct zipcheck_job	*job = (struct zipcheck_job *)arg;
+	mz_zip_archive		zip;
+	void			*buf = NULL;
+	size_t			bufsize = 0;
+
+	memset(&zip, 0, sizeof(mz_zip_archive));
+	if (!mz_zip_reader_init_mem(&zip, job->map, job->size, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+		return NULL;
+	}
+	for (;;) {
+		mz_zip_archive_file_stat	zsb;
+		mz_ulong			crc;
+		mz_uint				i;
+
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->nfiles) {
+			break;
+		}
+		if (mz_zip_reader_is_file_a_directory(&zip, i) || !mz_zip_reader_file_stat(&zip, i, &zsb)) {
+			continue;
+		}
+
+		if (!zipcheck_member(&zip, i, &zsb, &buf, &bufsize, &crc)) {
+			pthread_mutex_lock(&job->lock);
+			fprintf(stdout, "ZFile: %s/%s\tCorrupt (crc %08lx, expected %08x)\n",
+				job->path, zsb.m_filename, (unsigned long)crc, zsb.m_crc32);
+			job->bad++;
+			pthread_mutex_unlock(&job->lock);
+		} else if (job->mode & VERBOSE) {
+			pthread_mutex_lock(&job->lock);
+			fprintf(stdout, "ZFile: %s/%s\tIntact\n", job->path, zsb.m_filename);
+			pthread_mutex_unlock(&job->lock);
+		}
+	}
+	mz_zip_reader_end(&zip);
+	free(buf);
+
+	return NULL;
+}
+
+/*
+ * Inflate every member of the zip at path (or path.zip) and check it against
+ * its CRC.  Returns the number of bad members, or -1 if the zip couldn't be
+ * read.
+ */
+int
+zip_deep_verify(char *path, int mode)
+{
+	struct zipcheck_job	job;
+	pthread_t		threads[ZIPCHECK_MAX_THREADS];
+	struct stat		sb;
+	mz_zip_archive		zip;
+	long			nthreads;
+	int			in, i;
+
+	if ((in = open(path, O_RDONLY, 0)) == -1) {
+		char *zpath = sqlite3_mprintf("%s.zip", path);
+		in = open(zpath, O_RDONLY, 0);
+		sqlite3_free(zpath);
+		if (in == -1) {
+			return -1;
+		}
+	}
+	if (fstat(in, &sb) == -1 || sb.st_size == 0) {
+		close(in);
+		return -1;
+	}
+
+	job.path = path;
+	job.size = sb.st_size;
+	job.map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, in, 0);
+	close(in);
+	if (job.map == MAP_FAILED) {
+		return -1;
+	}
+
+	memset(&zip, 0, sizeof(mz_zip_archive));
+	if (!mz_zip_reader_init_mem(&zip, job.map, job.size, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+		munmap((void *)job.map, job.size);
+		return -1;
+	}
+	job.nfiles = mz_zip_reader_get_num_files(&zip);
+	mz_zip_reader_end(&zip);
+	job.next = 0;
+	job.bad = 0;
+	job.mode = mode;
+	pthread_mutex_init(&job.lock, NULL);
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (nthreads > (long)job.nfiles - 1) {
+		nthreads = job.nfiles - 1;
+	}
+	if (nthreads > ZIPCHECK_MAX_THREADS) {
+		nthreads = ZIPCHECK_MAX_THREADS;
+	}
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, zipcheck_worker, &job)) {
+			break;
+		}
+	}
+	nthreads = i;
+	zipcheck_worker(&job);
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+	munmap((void *)job.map, job.size);
+
+	return job.bad;
+}